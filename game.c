@@ -7,11 +7,32 @@
  * @date 2023
  */
 
+#define _POSIX_C_SOURCE 200809L
+
 #include "game.h"
 
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define BITPLANE_AVX2
+#endif
+
 /** @brief An auxiliary structure which keeps the player number and
- * the "color" of the field in the game_board (i.e. the number
- * of calls of the game_move function).
+ * the "color" of some field in the game_board. The color is an element
+ * of the disjoint-set structure kept in the game (see area_parent),
+ * two fields belong to the same area if and only if their colors have
+ * the same representative. It is used only for the neighbours of
+ * the field analysed in game_move, the board itself keeps the player
+ * numbers and the colors separately.
  */
 typedef struct Pair {
     uint64_t color;
@@ -55,6 +76,263 @@ typedef struct Player {
 // Describes the maximum possible number of players.
 #define MAX_PLAYERS 61
 
+// The board is split into square tiles of TILE_SIDE x TILE_SIDE fields.
+#define TILE_SHIFT 6
+#define TILE_SIDE (1U << TILE_SHIFT)
+#define TILE_MASK (TILE_SIDE - 1)
+#define TILE_FIELDS (TILE_SIDE * TILE_SIDE)
+
+// The tiles are grouped in directories of DIRECTORY_TILES tiles.
+#define DIRECTORY_SHIFT 9
+#define DIRECTORY_TILES (1U << DIRECTORY_SHIFT)
+#define DIRECTORY_MASK (DIRECTORY_TILES - 1)
+
+// The disjoint-set forest is split into blocks of AREA_BLOCK_COLORS colors.
+#define AREA_BLOCK_SHIFT 10
+#define AREA_BLOCK_COLORS (1U << AREA_BLOCK_SHIFT)
+#define AREA_BLOCK_MASK (AREA_BLOCK_COLORS - 1)
+
+// A tile with at most TILE_SPARSE_FIELDS busy fields keeps only these fields.
+#define TILE_SPARSE_FIELDS 32
+
+// The length of a tile keeping all its fields.
+#define TILE_DENSE UINT32_MAX
+
+/** @brief A tile of the game board. The field (x,y) of the board has
+ * the index ((x mod TILE_SIDE) * TILE_SIDE + (y mod TILE_SIDE)) in its tile.
+ * references      - the number of directories pointing to that tile,
+ * length          - TILE_DENSE for a dense tile, otherwise the number
+ *                   of busy fields of a sparse tile,
+ * colors          - a dense tile keeps here the colors of all TILE_FIELDS
+ *                   fields followed by their player numbers (zero for
+ *                   a free field, see tile_players), a sparse tile keeps
+ *                   TILE_SPARSE_FIELDS colors followed by the indices
+ *                   (see sparse_indices) and the player numbers of its
+ *                   busy fields, the first length entries are used.
+ * A new tile is sparse, it becomes dense when a move does not fit in it,
+ * so a huge board with few moves takes little memory.
+ *
+ * Tiles, directories and area blocks may be shared between a game and
+ * its clones (see game_clone). A shared one is never modified, a game
+ * copies it first (copy on write). The counters of references are atomic,
+ * so clones may be used by different threads.
+ */
+typedef struct Tile {
+    atomic_uint_fast32_t references;
+    uint32_t length;
+    uint64_t colors[];
+} tile_t;
+
+// The numbers of bytes of a dense and a sparse tile.
+#define DENSE_TILE_SIZE (sizeof(tile_t) + TILE_FIELDS * (sizeof(uint64_t) + 1))
+#define SPARSE_TILE_SIZE (sizeof(tile_t) + \
+                          TILE_SPARSE_FIELDS * (sizeof(uint64_t) + sizeof(uint16_t) + 1))
+
+// The distance from the field of a move to the farthest field it depends on.
+#define STENCIL_RADIUS 2
+#define STENCIL_SIDE (2 * STENCIL_RADIUS + 1)
+
+// The player number of a field outside the board in a stencil, no player
+// has that number.
+#define STENCIL_OUTSIDE UINT8_MAX
+
+/** @brief The neighbourhood of the field (x,y) analysed in game_move, read
+ * from the board in one pass by gather_stencil:
+ * players         - the player number of the field (x + dx, y + dy) at
+ *                   the distance |dx| + |dy| <= STENCIL_RADIUS is kept at
+ *                   [STENCIL_RADIUS + dx][STENCIL_RADIUS + dy], the fields
+ *                   outside the board have STENCIL_OUTSIDE, so the analysis
+ *                   of the move does not check the coordinates,
+ * colors          - the colors of the busy direct neighbours at the same places.
+ */
+typedef struct Stencil {
+    uint8_t players[STENCIL_SIDE][STENCIL_SIDE];
+    uint64_t colors[STENCIL_SIDE][STENCIL_SIDE];
+} stencil_t;
+
+/** @brief The direct neighbours of the field analysed in game_move, read
+ * from its stencil by read_neighbourhood:
+ * pairs           - the different pairs (player number, color) of the busy
+ *                   neighbours, the colors are not replaced by the
+ *                   representatives of their areas, so one area may be
+ *                   there more than once (see join_areas),
+ * pairs_length    - the number of the pairs,
+ * players         - the different player numbers of the busy neighbours,
+ * players_length  - the number of the player numbers,
+ * busy            - the number of the busy neighbours,
+ * potential       - the number of the neighbours inside the board.
+ * It is kept by the move, so the moves made at once by different threads
+ * (see game_move_concurrent) do not share it.
+ */
+typedef struct Neighbourhood {
+    pair_t pairs[MAX_NEIGHBOURS];
+    uint64_t pairs_length;
+    uint32_t players[MAX_NEIGHBOURS];
+    uint64_t players_length;
+    uint64_t busy;
+    uint64_t potential;
+} neighbourhood_t;
+
+// The offsets of the direct neighbours of a field: right, left, up, down.
+static int const neighbour_dx[MAX_NEIGHBOURS] = {1, -1, 0, 0};
+static int const neighbour_dy[MAX_NEIGHBOURS] = {0, 0, -1, 1};
+
+/** @brief A group of DIRECTORY_TILES consecutive tiles, NULL stands for
+ * a tile without any busy field.
+ */
+typedef struct Directory {
+    atomic_uint_fast32_t references;
+    tile_t* tiles[DIRECTORY_TILES];
+} directory_t;
+
+/** @brief A block of the disjoint-set forest of colors:
+ * parent          - a color is a representative of its area iff it is
+ *                   its own parent,
+ * size            - the number of colors in the tree of each representative
+ *                   (used for union by size).
+ */
+typedef struct Area_block {
+    atomic_uint_fast32_t references;
+    uint64_t parent[AREA_BLOCK_COLORS];
+    uint64_t size[AREA_BLOCK_COLORS];
+} area_block_t;
+
+/** @brief The frontier of one player, the set of free fields which have
+ * a busy neighbour of that player (so its size is the boundary_length of
+ * the player). It is an open addressing hash set with linear probing:
+ * capacity        - the number of slots, a power of two,
+ * length          - the number of fields in the set,
+ * fields          - the slots, the logical field indices (see field_index)
+ *                   or FRONTIER_EMPTY.
+ * Frontiers are shared with clones like the tiles.
+ */
+typedef struct Frontier {
+    atomic_uint_fast32_t references;
+    uint64_t capacity;
+    uint64_t length;
+    uint64_t fields[];
+} frontier_t;
+
+// Marks a free slot of a frontier.
+#define FRONTIER_EMPTY UINT64_MAX
+
+/** @brief A bitplane of the board, one bit per field. The column x of
+ * the board takes plane_stride words starting at the word
+ * (x + 1) * plane_stride, the field (x,y) is the bit y mod 64 of the word
+ * 1 + y / 64 of its column. The first and the last word of every column
+ * and the columns before and after the board are zero guards, so
+ * the neighbours of any field may be read without checking the edges.
+ * Bitplanes are shared with clones like the tiles.
+ */
+typedef struct Bitplane {
+    atomic_uint_fast32_t references;
+    uint64_t words[];
+} bitplane_t;
+
+// Boards with (players + 1) * width * height not greater than that number
+// of bits keep bitplanes instead of frontiers (see game_new).
+#define BITPLANE_MAX_BITS (1ULL << 26)
+
+// The number of words of one column processed at once by the frontier kernel.
+#define BITPLANE_CHUNK 64
+
+/** @brief A file mapped by game_open_mapped, shared by the game and its
+ * clones and unmapped with the last of them:
+ * address         - the beginning of the mapping,
+ * length          - the length of the mapping (and of the file),
+ * path            - the name of the file, used by game_sync.
+ * The tiles, area blocks, frontiers and bitplanes of the file are used
+ * in place. Their counters of references are set to MAPPED_REFERENCES when
+ * the file is opened, one of them belongs to the file, so they are never
+ * freed and they are copied before the first write like the shared ones. The mapping is
+ * private, so the file is never modified through it.
+ */
+typedef struct Mapping {
+    atomic_uint_fast32_t references;
+    void* address;
+    size_t length;
+    char* path;
+} mapping_t;
+
+// The counter of references of a piece of a mapped file.
+#define MAPPED_REFERENCES 2
+
+/** @brief The memory of a game and all its clones, it is released with
+ * the last of them:
+ * used            - the number of bytes allocated now (with the heap),
+ * allocator       - the allocator given to game_new_ex, the allocate callback
+ *                   is NULL for malloc and free.
+ * Every piece of a game is freed by the heap which allocated it, so pieces
+ * may be shared only by games with the same heap.
+ */
+typedef struct Heap {
+    atomic_uint_fast32_t references;
+    atomic_uint_fast64_t used;
+    game_allocator_t allocator;
+} heap_t;
+
+/** @brief The allocator made by game_arena_new, the bump allocator of one
+ * region:
+ * allocator       - the allocator given to the user, its context is the arena,
+ * next            - the offset of the first free byte of the region,
+ * size            - the size of the region,
+ * region          - the memory handed out.
+ */
+typedef struct Arena {
+    game_allocator_t allocator;
+    atomic_size_t next;
+    size_t size;
+    _Alignas(max_align_t) unsigned char region[];
+} arena_t;
+
+// The maximal number of the regions of the board locked by concurrent moves.
+#define MAX_REGIONS (1U << 12)
+
+// The maximal number of the regions of the stencil of one move.
+#define STENCIL_REGIONS 4
+
+// The concurrent mode allocates all directories of the board, so it is
+// refused for boards with more directories.
+#define MAX_CONCURRENT_DIRECTORIES (1U << 16)
+
+/** @brief The part of the concurrent mode belonging to one player:
+ * lock            - guards the counters, the frontier and the bitplane of
+ *                   the player and the rest of this structure,
+ * next_color      - the next color reserved for the new areas of the player,
+ * colors_end      - the end of the range of his reserved colors,
+ * block           - the area block of that range,
+ * hash            - the xor of the Zobrist keys of his moves.
+ */
+typedef struct Player_lock {
+    pthread_mutex_t lock;
+    uint64_t next_color;
+    uint64_t colors_end;
+    area_block_t* block;
+    uint64_t hash;
+} player_lock_t;
+
+/** @brief The state of the concurrent mode (see game_set_concurrent):
+ * players         - the parts of the players,
+ * forest          - guards the disjoint-set forest and next_color of the game,
+ *                   it is taken only by the moves joining different areas
+ *                   and to reserve the next range of colors of a player,
+ * regions_length  - the number of the regions of the board, a power of two,
+ * regions         - the locks of the regions, the tile with the number t
+ *                   belongs to the region t mod regions_length.
+ * A move takes the locks of the regions of its stencil, then the locks of
+ * its player and the players of its neighbours and at last the lock of
+ * the forest, the regions and the players in the increasing order of their
+ * numbers, so the moves never wait for each other in a cycle. A new area
+ * takes a reserved color of its player, so most moves do not take the lock
+ * of the forest.
+ */
+typedef struct Concurrency {
+    player_lock_t players[MAX_PLAYERS];
+    pthread_mutex_t forest;
+    uint64_t regions_length;
+    pthread_mutex_t regions[];
+} concurrency_t;
+
 /** @brief This structure represents the whole game.
  * width                 - non negative number describing the width
  *                         of the game board,
@@ -63,600 +341,3576 @@ typedef struct Player {
  * number_of_players     - non negative number representing the number of players,
  * max_areas             - non negative number representing the maximum
  *                         of free to take areas by each of the player,
- * game_board            - the matrix representing game status,
+ * directories           - the game board, the tile of the field (x,y) has
+ *                         the number (x / TILE_SIDE) * tiles_height + y / TILE_SIDE
+ *                         and the directory of the tile t has the number
+ *                         t / DIRECTORY_TILES; a tile and a directory are
+ *                         allocated when the first figure is put in them,
+ *                         and a tile is sparse until it has more than
+ *                         TILE_SPARSE_FIELDS busy fields,
  * all_players           - the array of all players,
- * diff_pair_neighbour   - helper array holding for some coordinate (x,y) all
- *                         his different direct neighbours (neighbour_number, field_color),
- * diff_neighbour_number - helper array similar to diff_pair_neighbour but holding only
- *                         different neighhours player_numbers for some fixed (x,y) coordinate,
- * busy_neighbour_fields - number of direct neighbours for some (x,y) field,
- * fields_to_take        - non negative number of free fields in the game_board.
+ * frontiers             - the frontiers of all players, NULL before the first
+ *                         move of the player (or always with bitplanes),
+ * planes                - NULL for big boards, otherwise the occupancy bitplane
+ *                         (planes[0], its bits after the last row are set) and
+ *                         the bitplanes of the fields of every player, NULL
+ *                         before the first move of the player; the frontiers
+ *                         are computed from them (see frontier_words),
+ * fields_to_take        - non negative number of free fields in the game_board,
+ * full_players          - the bit p - 1 is set if the player p occupied all
+ *                         possible areas,
+ * bordered_players      - the bit p - 1 is set if the boundary_length of
+ *                         the player p is positive; both masks are updated
+ *                         with the players (see update_player_masks), so
+ *                         the players who can move are known at once
+ *                         (see movable_players),
+ * hash                  - the Zobrist hash of the board, the xor of the keys
+ *                         of all busy fields (see zobrist_key),
+ * area_blocks           - the disjoint-set forest of all colors, the color c
+ *                         is kept in the block c / AREA_BLOCK_COLORS,
+ * next_color            - the color of the next created area; it is for coloring
+ *                         the connected fragments of fields of the same figure
+ *                         number, each move creating a new area takes that value
+ *                         as the color of the area and increases it by 1,
+ * journal               - the records of all moves made since the journal was
+ *                         turned on (see the description of JOURNAL_* constants),
+ * redo                  - the stack of undone moves, two words (the field index and
+ *                         the player number) per move,
+ * mapping               - the file the game was opened from or NULL,
+ * heap                  - the memory of the game, shared with its clones,
+ * concurrency           - the state of the concurrent mode or NULL,
+ * stats                 - the counters returned by game_stats, present only
+ *                         with GAME_STATS.
+ *
+ * All the state of one game is kept here, so different games do not share
+ * any data. In the concurrent mode the masks of the players, fields_to_take,
+ * hash and the numbers of the tiles are not updated by the moves, they are
+ * computed again when the mode ends.
  */
 struct game {
-    pair_t diff_pair_neighbour[MAX_NEIGHBOURS];
-    uint32_t diff_neighbour_number[MAX_NEIGHBOURS];
-    uint64_t length_diff_neighbour_number; ///< Length of diff_neighbour_number.
-    uint64_t busy_neighbour_fields;
     uint64_t fields_to_take;
-    uint64_t potential_neighbour_number; ///< Number of all "valid" neighbour coordinates.
+    uint64_t full_players;
+    uint64_t bordered_players;
+    uint64_t hash;
     uint32_t width;
     uint32_t height;
     uint32_t number_of_players;
     uint32_t max_areas;
-    pair_t** game_board;
+    directory_t** directories;
+    uint64_t number_of_directories; ///< Length of directories.
+    uint64_t tiles_height; ///< Number of tiles in one column of tiles.
+    uint64_t allocated_directories; ///< Number of non NULL directories.
+    uint64_t allocated_tiles; ///< Number of non NULL tiles in all directories.
+    uint64_t dense_tiles; ///< Number of dense tiles in all directories.
     player_t* all_players;
+    frontier_t** frontiers;
+    bitplane_t** planes;
+    uint64_t plane_stride; ///< Number of words of one column of a bitplane.
+    uint64_t plane_words; ///< Number of words of a bitplane.
+    area_block_t** area_blocks;
+    uint64_t number_of_area_blocks; ///< Length of area_blocks.
+    uint64_t allocated_area_blocks; ///< Number of non NULL area_blocks.
+    uint64_t next_color;
+    uint64_t* journal;
+    uint64_t journal_length;
+    uint64_t journal_capacity;
+    uint64_t* redo;
+    uint64_t redo_length;
+    uint64_t redo_capacity;
+    bool journal_enabled;
+    mapping_t* mapping;
+    heap_t* heap;
+    concurrency_t* concurrency;
+#ifdef GAME_STATS
+    game_stats_t stats;
+#endif
 };
 
-// This constant is for coloring the connected fragments of fields of
-// the same figure number. In each iteration of game_move the
-// global counter will be increasing by 1.
-uint64_t GLOBAL_COUNTER = 1;
-
+// The initial number of entries in the growing arrays.
+#define INITIAL_CAPACITY 64
+
+// Increases the counter of game_stats_t by one or by n, compiled only
+// with GAME_STATS. In the concurrent mode many threads count at once, so
+// the counters (plain fields of the public structure) are added atomically.
+#ifdef GAME_STATS
+#define COUNT_ADD(g, counter, n) \
+    ((g)->concurrency ? (void)__atomic_fetch_add(&(g)->stats.counter, (n), __ATOMIC_RELAXED) : \
+                        (void)((g)->stats.counter += (n)))
+#define COUNT(g, counter) COUNT_ADD(g, counter, 1)
+#else
+#define COUNT(g, counter) ((void)(g))
+#define COUNT_ADD(g, counter, n) ((void)(g), (void)(n))
+#endif
+
+/**
+ * Every move made with the journal turned on appends one record to
+ * the journal. The record consists of two words for every union of areas
+ * made by the move (the color attached to the other one and that other
+ * color), the index of the taken field and the description word:
+ * bits 0-7            - the player number,
+ * bit JOURNAL_NEW_AREA - set if the move created a new area,
+ * JOURNAL_UNIONS      - the number of unions (the number of joined areas),
+ * JOURNAL_BOUNDARY    - the increase of the boundary_length of the player,
+ * JOURNAL_NEIGHBOURS  - the number of different neighbour player numbers,
+ *                       their boundary_length decreased by one,
+ * JOURNAL_NEIGHBOUR   - these player numbers, 8 bits each.
+ * The description word is the last one, so the records are read from
+ * the end of the journal. The paths in the disjoint-set forest are not
+ * compressed while the journal is on, so undoing the unions in reverse
+ * order restores the forest exactly.
+ */
+#define JOURNAL_PLAYER_MASK 0xFFULL
+#define JOURNAL_NEW_AREA (1ULL << 8)
+#define JOURNAL_UNIONS 9
+#define JOURNAL_BOUNDARY 12
+#define JOURNAL_NEIGHBOURS 15
+#define JOURNAL_NEIGHBOUR 18
+#define JOURNAL_FIELD_BITS 0x7ULL
+#define JOURNAL_MAX_RECORD (2 * (MAX_NEIGHBOURS - 1) + 2)
+
+// Returns true if the tile, directory or area block is not shared.
+static bool exclusive(atomic_uint_fast32_t* references) {
+    return atomic_load_explicit(references, memory_order_acquire) == 1;
+}
 
-static uint64_t min(uint64_t const x, uint64_t const y) {
-    return x <= y ? x : y;
+// Adds one reference to the tile, directory or area block.
+static void share(atomic_uint_fast32_t* references) {
+    atomic_fetch_add_explicit(references, 1, memory_order_relaxed);
 }
 
-// An auxilary function for correct delete
-// malloced memory in game_new function.
-static void remove_struct(game_t* g, player_t* all_players, pair_t** first_row,
-                          pair_t* all_board) {
-    free(all_players);
-    free(all_board);
-    free(first_row);
-    free(g);
+// Removes one reference, returns true if it was the last one.
+static bool release(atomic_uint_fast32_t* references) {
+    return atomic_fetch_sub_explicit(references, 1, memory_order_acq_rel) == 1;
 }
 
-game_t* game_new(uint32_t width, uint32_t height, uint32_t players, uint32_t areas) {
+// Allocates size bytes of the heap, cleared if zeroed is true. Returns NULL
+// and sets errno to ENOMEM if the allocation failed or the budget of
+// the heap would be exceeded.
+static void* heap_allocate(heap_t* heap, size_t const size, bool const zeroed) {
+    uint64_t budget = heap->allocator.budget;
 
-     // Firstly check if the input is correct.
-    if (width == 0 || height == 0 || players == 0 || areas == 0 || players > MAX_PLAYERS) {
+    if (atomic_fetch_add_explicit(&heap->used, size, memory_order_relaxed) + size > budget &&
+        budget != 0) {
+        atomic_fetch_sub_explicit(&heap->used, size, memory_order_relaxed);
+        errno = ENOMEM;
         return NULL;
     }
 
-    game_t* g = NULL;
-    player_t* all_players = NULL;
-    pair_t** game_board = NULL;
-    pair_t** first_row = NULL;
-    pair_t* all_board = NULL;
+    void* pointer;
 
-    g = calloc(1, sizeof(game_t));
-    all_players = calloc(players, sizeof(player_t));
-    first_row = (pair_t**)malloc(width * sizeof(pair_t*));
-    all_board = (pair_t*)calloc((uint64_t)width * (uint64_t)height, sizeof(pair_t));
+    if (!heap->allocator.allocate) {
+        pointer = zeroed ? calloc(1, size) : malloc(size);
+    }
+    else if ((pointer = heap->allocator.allocate(heap->allocator.context, size)) && zeroed) {
+        memset(pointer, 0, size);
+    }
 
-    if (!g || !all_players || !first_row || !all_board) {
-        remove_struct(g, all_players, first_row, all_board);
+    if (!pointer) {
+        atomic_fetch_sub_explicit(&heap->used, size, memory_order_relaxed);
+        errno = ENOMEM;
+    }
 
-        return NULL;
+    return pointer;
+}
+
+// Frees the memory of the given size allocated by the heap, NULL is ignored.
+static void heap_free(heap_t* heap, void* pointer, size_t const size) {
+    if (!pointer) {
+        return;
+    }
+
+    atomic_fetch_sub_explicit(&heap->used, size, memory_order_relaxed);
+
+    if (!heap->allocator.allocate) {
+        free(pointer);
+    }
+    else {
+        heap->allocator.deallocate(heap->allocator.context, pointer, size);
     }
+}
 
-    for (uint32_t i = 0; i < width; i++) {
-        first_row[i] = &all_board[(uint64_t)i * (uint64_t)height];
+// Changes the size of the memory allocated by the heap like realloc, but
+// it keeps the old memory if the allocation failed and sets errno to ENOMEM.
+static void* heap_reallocate(heap_t* heap, void* pointer, size_t const old_size,
+                             size_t const size) {
+    void* new_pointer = heap_allocate(heap, size, false);
+
+    if (new_pointer && pointer) {
+        memcpy(new_pointer, pointer, old_size < size ? old_size : size);
+        heap_free(heap, pointer, old_size);
     }
 
-    game_board = first_row;
+    return new_pointer;
+}
 
-    // First 9 players will have 1,...,9 as a player symbol.
-    // Next players are denoted alphabetically (using large
-    // and small letters).
-    for (uint32_t i = 0; i < players; i++) {
-        if (i < FIRST_NINE_PLAYERS) {
-            all_players[i].player_symbol = (char)('1' + i);
-        }
-        else if (i >= FIRST_NINE_PLAYERS && i < FIRST_THIRTY_FIVE_PLAYERS) {
-            all_players[i].player_symbol = (char)('a' + (i - FIRST_NINE_PLAYERS));
-        }
-        else {
-            all_players[i].player_symbol = (char)('A' + (i - FIRST_THIRTY_FIVE_PLAYERS));
-        }
+// Creates the heap using the allocator (or malloc for NULL) with one
+// reference. Returns NULL and sets errno to ENOMEM if it failed.
+static heap_t* new_heap(game_allocator_t const* allocator) {
+    heap_t helper;
+
+    atomic_init(&helper.used, 0);
+    memset(&helper.allocator, 0, sizeof(game_allocator_t));
+
+    if (allocator) {
+        helper.allocator = *allocator;
     }
 
-    // The game creating.
-    g->width = width;
-    g->height = height;
-    g->number_of_players = players;
-    g->max_areas = areas;
-    g->game_board = game_board;
-    g->all_players = all_players;
-    g->fields_to_take = (uint64_t)width * (uint64_t)height;
+    heap_t* heap = heap_allocate(&helper, sizeof(heap_t), false);
 
-    // Always set GLOBAL_COUNTER to 1 when new_game is created.
-    GLOBAL_COUNTER = 1;
+    if (!heap) {
+        return NULL;
+    }
 
-    return g;
+    atomic_init(&heap->references, 1);
+    atomic_init(&heap->used, atomic_load(&helper.used));
+    heap->allocator = helper.allocator;
+
+    return heap;
 }
 
-void game_delete(game_t* g) {
-    if (g) {
-        pair_t** first_row = g->game_board;
-        pair_t* all_board = g->game_board[0];
+static void release_heap(heap_t* heap) {
+    if (heap && release(&heap->references)) {
+        heap_t helper = *heap;
 
-        remove_struct(g, g->all_players, first_row, all_board);
+        heap_free(&helper, heap, sizeof(heap_t));
     }
 }
 
-// Returns true if the player_number is correct and false otherwise.
-static bool correct_player_number(game_t const* g, uint32_t const player_number) {
-    return (!(player_number == 0 || player_number > g->number_of_players));
+// Returns the number of bytes of the tile.
+static uint64_t tile_size(tile_t const* tile) {
+    return tile->length == TILE_DENSE ? DENSE_TILE_SIZE : SPARSE_TILE_SIZE;
 }
 
-// Returns true if the player occupied all possible aries and false otherwise.
-static bool player_occupied_all_areas(game_t const* g, uint32_t const player_number) {
-    return (g->all_players[player_number - 1].busy_areas == g->max_areas);
+// Returns the number of bytes of the frontier.
+static uint64_t frontier_size(frontier_t const* frontier) {
+    return sizeof(frontier_t) + frontier->capacity * sizeof(uint64_t);
 }
 
-// Returns true if the coordinate is valid and false otherwise.
-static bool correct_coordinate(game_t const* g, uint32_t const x, uint32_t const y) {
-    return (!(x >= g->width || y >= g->height));
+// Returns the number of bytes of a bitplane of the game.
+static uint64_t plane_size(game_t const* g) {
+    return sizeof(bitplane_t) + g->plane_words * sizeof(uint64_t);
 }
 
-// Returns true if the coordinate (x,y) is already occupied and false otherwise.
-static bool empty_coordinate(game_t const* g, uint32_t const x, uint32_t const y) {
-    return (g->game_board[x][y].player_number == 0);
+static void release_tile(game_t* g, tile_t* tile) {
+    if (tile && release(&tile->references)) {
+        heap_free(g->heap, tile, tile_size(tile));
+    }
 }
 
-// Helper function in update_structure procedure which is adding the new pair to array.
-static void add_to_array(int* position, pair_t* neighbours, pair_t value_to_add,
-                         uint64_t* length) {
-    for (int i = 0; i < *position; i++) {
-        if (neighbours[i].player_number == value_to_add.player_number &&
-           neighbours[i].color == value_to_add.color) {
-            return;
+static void release_directory(game_t* g, directory_t* directory) {
+    if (directory && release(&directory->references)) {
+        for (uint32_t i = 0; i < DIRECTORY_TILES; i++) {
+            release_tile(g, directory->tiles[i]);
         }
+
+        heap_free(g->heap, directory, sizeof(directory_t));
+    }
+}
+
+static void release_area_block(game_t* g, area_block_t* block) {
+    if (block && release(&block->references)) {
+        heap_free(g->heap, block, sizeof(area_block_t));
+    }
+}
+
+static void release_frontier(game_t* g, frontier_t* frontier) {
+    if (frontier && release(&frontier->references)) {
+        heap_free(g->heap, frontier, frontier_size(frontier));
     }
+}
 
-    neighbours[*position].player_number = value_to_add.player_number;
-    neighbours[*position].color = value_to_add.color;
-    (*position)++;
-    (*length)++;
+static void release_plane(game_t* g, bitplane_t* plane) {
+    if (plane && release(&plane->references)) {
+        heap_free(g->heap, plane, plane_size(g));
+    }
 }
 
-// Working with neighbours of (x,y) coordinate.
-// Update all g members which depend on (x,y) coordinate in the
-// definition.
-static void update_structure(game_t* g, uint32_t x, uint32_t y) {
-    uint64_t length_diff_pair_neighbour = 0;
-    uint64_t length_diff_neighbour_number = 0;
-    uint64_t busy_neighbour_fields = 0;
-    uint64_t potential_neighbour_number = 0;
-    bool valid_right = correct_coordinate(g, x + 1, y);
-    bool valid_left = correct_coordinate(g, x - 1, y);
-    bool valid_down = correct_coordinate(g, x, y + 1);
-    bool valid_up = correct_coordinate(g, x, y - 1);
-    int position = 0;
+static void release_mapping(game_t* g, mapping_t* mapping) {
+    if (mapping && release(&mapping->references)) {
+        munmap(mapping->address, mapping->length);
+        heap_free(g->heap, mapping->path, strlen(mapping->path) + 1);
+        heap_free(g->heap, mapping, sizeof(mapping_t));
+    }
+}
 
-    // Update the array diff_pair_neighbour and busy_neighbour_fields,
-    // Update the length_diff_pair_neighbour.
-    if (valid_right) {
-        potential_neighbour_number++;
+// Destroys the locks of the concurrent mode and frees its state.
+static void release_concurrency(game_t* g) {
+    concurrency_t* concurrency = g->concurrency;
 
-        if (!empty_coordinate(g, x + 1, y)) {
-            busy_neighbour_fields++;
-            add_to_array(&position, g->diff_pair_neighbour,
-                         g->game_board[x + 1][y], &length_diff_pair_neighbour);
-        }
+    for (uint32_t i = 0; i < MAX_PLAYERS; i++) {
+        pthread_mutex_destroy(&concurrency->players[i].lock);
+    }
+    for (uint64_t i = 0; i < concurrency->regions_length; i++) {
+        pthread_mutex_destroy(&concurrency->regions[i]);
     }
-    if (valid_left) {
-        potential_neighbour_number++;
 
-        if (!empty_coordinate(g, x - 1, y)) {
-            busy_neighbour_fields++;
-            add_to_array(&position, g->diff_pair_neighbour,
-                         g->game_board[x - 1][y], &length_diff_pair_neighbour);
-        }
+    pthread_mutex_destroy(&concurrency->forest);
+    heap_free(g->heap, concurrency, sizeof(concurrency_t) +
+                                    concurrency->regions_length * sizeof(pthread_mutex_t));
+    g->concurrency = NULL;
+}
+
+// An auxilary function for correct delete
+// malloced memory in game_new and game_clone functions.
+static void remove_struct(game_t* g) {
+    heap_t* heap = g->heap;
+
+    if (g->concurrency) {
+        release_concurrency(g);
     }
-    if (valid_up) {
-        potential_neighbour_number++;
 
-        if (!empty_coordinate(g, x, y - 1)) {
-            busy_neighbour_fields++;
-            add_to_array(&position, g->diff_pair_neighbour,
-                         g->game_board[x][y - 1], &length_diff_pair_neighbour);
+    if (g->directories) {
+        for (uint64_t i = 0; i < g->number_of_directories; i++) {
+            release_directory(g, g->directories[i]);
         }
     }
-    if (valid_down) {
-        potential_neighbour_number++;
-
-        if (!empty_coordinate(g, x, y + 1)) {
-            busy_neighbour_fields++;
-            add_to_array(&position, g->diff_pair_neighbour,
-                         g->game_board[x][y + 1], &length_diff_pair_neighbour);
+    if (g->area_blocks) {
+        for (uint64_t i = 0; i < g->number_of_area_blocks; i++) {
+            release_area_block(g, g->area_blocks[i]);
+        }
+    }
+    if (g->frontiers) {
+        for (uint32_t i = 0; i < g->number_of_players; i++) {
+            release_frontier(g, g->frontiers[i]);
+        }
+    }
+    if (g->planes) {
+        for (uint32_t i = 0; i <= g->number_of_players; i++) {
+            release_plane(g, g->planes[i]);
         }
     }
 
-    // Update the g.diff_neighbour_numbers.
-    bool copy;
-
-    for (uint64_t i = 0; i < length_diff_pair_neighbour; i++) {
-        copy = false;
+    release_mapping(g, g->mapping);
+    heap_free(heap, g->directories, g->number_of_directories * sizeof(directory_t*));
+    heap_free(heap, g->frontiers, g->number_of_players * sizeof(frontier_t*));
+    heap_free(heap, g->planes, (g->number_of_players + 1) * sizeof(bitplane_t*));
+    heap_free(heap, g->area_blocks, g->number_of_area_blocks * sizeof(area_block_t*));
+    heap_free(heap, g->journal, g->journal_capacity * sizeof(uint64_t));
+    heap_free(heap, g->redo, g->redo_capacity * sizeof(uint64_t));
+    heap_free(heap, g->all_players, g->number_of_players * sizeof(player_t));
+    heap_free(heap, g, sizeof(game_t));
+    release_heap(heap);
+}
 
-        for (uint64_t z = 0; z < length_diff_neighbour_number; z++) {
-            if (g->diff_pair_neighbour[i].player_number == g->diff_neighbour_number[z]) {
-                copy = true;
-                break;
-            }
+// Sets the bits of the occupancy bitplane after the last row, these fields
+// are never free.
+static void mark_rows_after_board(game_t const* g, bitplane_t* occupied) {
+    if (g->height % 64 != 0) {
+        for (uint64_t x = 1; x <= g->width; x++) {
+            occupied->words[(x + 1) * g->plane_stride - 2] = ~0ULL << (g->height % 64);
         }
+    }
+}
 
-        if (!copy) {
-            g->diff_neighbour_number[length_diff_neighbour_number] =
-               g->diff_pair_neighbour[i].player_number;
-            length_diff_neighbour_number++;
-        }
+// Allocates the occupancy bitplane if the board with all planes of players
+// has at most BITPLANE_MAX_BITS bits, bigger boards keep frontiers.
+// Returns false if the allocation failed.
+static bool new_planes(game_t* g) {
+    if ((uint64_t)g->width * g->height > BITPLANE_MAX_BITS / (g->number_of_players + 1)) {
+        return true;
     }
 
-    g->length_diff_neighbour_number = length_diff_neighbour_number;
-    g->busy_neighbour_fields = busy_neighbour_fields;
-    g->potential_neighbour_number = potential_neighbour_number;
-}
+    g->plane_stride = ((uint64_t)g->height + 63) / 64 + 2;
+    g->plane_words = ((uint64_t)g->width + 2) * g->plane_stride;
+    g->planes = heap_allocate(g->heap, (g->number_of_players + 1) * sizeof(bitplane_t*), true);
 
-/** @brief Checks if adding new figure generates a new area for the player.
- * @param[in] neighbours      - is the array of diff_pair_neighbour of the player,
- * @param[in] player_number   - the player number.
- * @return true if adding creates the new area and false otherwise.
- */
-static bool boundary_adding(pair_t const* neighbours, uint32_t const player_number) {
-    int i = 0;
+    if (!g->planes) {
+        return false;
+    }
 
-    while (neighbours[i].player_number != 0 && i < 4) {
-        if (neighbours[i].player_number == player_number) {
-            return true;
-        }
-        i++;
+    bitplane_t* occupied = heap_allocate(g->heap, plane_size(g), true);
+
+    if (!occupied) {
+        return false;
     }
 
-    return false;
+    atomic_init(&occupied->references, 1);
+    mark_rows_after_board(g, occupied);
+    g->planes[0] = occupied;
+
+    return true;
 }
 
-/** @brief An auxilary function which analyses free neighbour cell
- *  of the coordinate c := (x,y) and add +1 to the answer if that
- *  field has its own neighbour (different that c) with the
- *  same figure number as in c.
- * @param[in] g               - pointer to the game structure,
- * @param[in] x               - column number,
- * @param[in] y               - row number,
- * @param[in] player_number   - the number of the figure we put at (x,y) coordinate.
- * @return The number of empty diff_pair_neighbour of the (x,y) coordinate which has
- * in their own diff_pair_neighbour the player_number.
- */
-static uint64_t check_non_direct_neighbours(game_t const* g, uint32_t x,
-                                             uint32_t y, uint32_t player_number) {
-    uint64_t answer = 0;
-    bool valid_left = correct_coordinate(g, x - 1, y);
-    bool valid_right = correct_coordinate(g, x + 1, y);
-    bool valid_up = correct_coordinate(g, x, y - 1);
-    bool valid_down = correct_coordinate(g, x, y + 1);
+game_t* game_new(uint32_t width, uint32_t height, uint32_t players, uint32_t areas) {
+    return game_new_ex(width, height, players, areas, NULL);
+}
 
-    // Define 3 bool variables for checking the validity of
-    // non direct variables ("neighbours" of my neighbour).
-    bool technical1;
-    bool technical2;
-    bool technical3;
+game_t* game_new_ex(uint32_t width, uint32_t height, uint32_t players, uint32_t areas,
+                    game_allocator_t const* allocator) {
 
-    if (valid_left && empty_coordinate(g, x - 1, y)) {
-        technical1 = correct_coordinate(g, x - 2, y);
-        technical2 = correct_coordinate(g, x - 1, y + 1);
-        technical3 = correct_coordinate(g, x - 1, y - 1);
+     // Firstly check if the input is correct.
+    if (width == 0 || height == 0 || players == 0 || areas == 0 || players > MAX_PLAYERS) {
+        return NULL;
+    }
 
-        if ((technical1 && g->game_board[x - 2][y].player_number == player_number) ||
-            (technical2 && g->game_board[x - 1][y + 1].player_number == player_number) ||
-            (technical3 && g->game_board[x - 1][y - 1].player_number == player_number)) {
-                answer++;
-        }
+    heap_t* heap = new_heap(allocator);
+    game_t* g = heap ? heap_allocate(heap, sizeof(game_t), true) : NULL;
+
+    if (!g) {
+        release_heap(heap);
+
+        return NULL;
     }
-    if (valid_right && empty_coordinate(g, x + 1, y)) {
-            technical1 = correct_coordinate(g, x + 2, y);
-            technical2 = correct_coordinate(g, x + 1, y - 1);
-            technical3 = correct_coordinate(g, x + 1, y + 1);
 
-        if ((technical1 && g->game_board[x + 2][y].player_number == player_number) ||
-           (technical2 && g->game_board[x + 1][y - 1].player_number == player_number) ||
-           (technical3 && g->game_board[x + 1][y + 1].player_number == player_number)) {
-                answer++;
-        }
+    g->heap = heap;
+
+    uint64_t tiles_width = ((uint64_t)width + TILE_SIDE - 1) / TILE_SIDE;
+
+    g->tiles_height = ((uint64_t)height + TILE_SIDE - 1) / TILE_SIDE;
+    g->number_of_directories = (tiles_width * g->tiles_height + DIRECTORY_TILES - 1) /
+                               DIRECTORY_TILES;
+    g->number_of_players = players;
+    g->all_players = heap_allocate(heap, players * sizeof(player_t), true);
+    g->frontiers = heap_allocate(heap, players * sizeof(frontier_t*), true);
+    g->directories = heap_allocate(heap, g->number_of_directories * sizeof(directory_t*), true);
+
+    if (!g->all_players || !g->frontiers || !g->directories) {
+        remove_struct(g);
+
+        return NULL;
     }
-    if (valid_up && empty_coordinate(g, x, y - 1)) {
-        technical1 = correct_coordinate(g, x, y - 2);
-        technical2 = correct_coordinate(g, x - 1, y - 1);
-        technical3 = correct_coordinate(g, x + 1, y - 1);
 
-        if ((technical1 && g->game_board[x][y - 2].player_number == player_number) ||
-            (technical2 && g->game_board[x - 1][y - 1].player_number == player_number) ||
-            (technical3 && g->game_board[x + 1][y - 1].player_number == player_number)) {
-                answer++;
+    // First 9 players will have 1,...,9 as a player symbol.
+    // Next players are denoted alphabetically (using large
+    // and small letters).
+    for (uint32_t i = 0; i < players; i++) {
+        if (i < FIRST_NINE_PLAYERS) {
+            g->all_players[i].player_symbol = (char)('1' + i);
+        }
+        else if (i >= FIRST_NINE_PLAYERS && i < FIRST_THIRTY_FIVE_PLAYERS) {
+            g->all_players[i].player_symbol = (char)('a' + (i - FIRST_NINE_PLAYERS));
+        }
+        else {
+            g->all_players[i].player_symbol = (char)('A' + (i - FIRST_THIRTY_FIVE_PLAYERS));
         }
     }
-    if (valid_down && empty_coordinate(g, x, y + 1)) {
-        technical1 = correct_coordinate(g, x, y + 2);
-        technical2 = correct_coordinate(g, x - 1, y + 1);
-        technical3 = correct_coordinate(g, x + 1, y + 1);
 
-        if ((technical1 && g->game_board[x][y + 2].player_number == player_number) ||
-            (technical2 && g->game_board[x - 1][y + 1].player_number == player_number) ||
-            (technical3 && g->game_board[x + 1][y + 1].player_number == player_number)) {
-                answer++;
-        }
+    // The game creating.
+    g->width = width;
+    g->height = height;
+    g->max_areas = areas;
+    g->fields_to_take = (uint64_t)width * (uint64_t)height;
+    g->next_color = 1;
+
+    if (!new_planes(g)) {
+        remove_struct(g);
+
+        return NULL;
     }
 
-    return answer;
+    return g;
 }
 
-// Reset all auxilary data in game structure to zero.
-static void set_to_zero(game_t* g) {
-    for (int i = 0; i < 4; i++) {
-        g->diff_pair_neighbour[i].player_number = 0;
-        g->diff_pair_neighbour[i].color = 0;
-        g->diff_neighbour_number[i] = 0;
-    }
+// Rounds the size up to the alignment of the arena blocks.
+static size_t arena_block_size(size_t const size) {
+    size_t const alignment = _Alignof(max_align_t);
+
+    return (size + alignment - 1) / alignment * alignment;
 }
 
-// Looks at all direct busy neighbour fields having player_number figure
-// on it and returns their minimum color.
-static uint64_t find_min_color(game_t const* g, uint32_t player_number) {
-    uint64_t answer = UINT64_MAX;
+static void* arena_allocate(void* context, size_t const size) {
+    arena_t* arena = context;
+    size_t const block = arena_block_size(size);
+    size_t next = atomic_load_explicit(&arena->next, memory_order_relaxed);
 
-    for (int i = 0; i < 4; i++) {
-        if (g->diff_pair_neighbour[i].player_number == player_number) {
-            answer = min(answer, g->diff_pair_neighbour[i].color);
+    do {
+        if (block > arena->size - next) {
+            return NULL;
         }
-    }
+    } while (!atomic_compare_exchange_weak_explicit(&arena->next, &next, next + block,
+                                                    memory_order_relaxed,
+                                                    memory_order_relaxed));
 
-    return answer;
+    return arena->region + next;
 }
 
-// Recursive function for recoloring different fragments of the same
-// player. The parameter min_color describes the new color of that fragments.
-static void BFS(game_t* g, uint32_t x, uint32_t y, uint64_t min_color,
-                uint64_t player_number) {
-     if (!correct_coordinate(g, x, y)) {
-         return;
-     }
+// Gives the block back only if it is the last one, the rest of the region
+// is reused after the arena is deleted.
+static void arena_deallocate(void* context, void* pointer, size_t const size) {
+    arena_t* arena = context;
+    size_t const offset = (size_t)((unsigned char*)pointer - arena->region);
+    size_t next = offset + arena_block_size(size);
 
-     if (g->game_board[x][y].player_number == player_number &&
-         g->game_board[x][y].color != min_color) {
-            g->game_board[x][y].color = min_color;
-            BFS(g, x + 1, y, min_color, player_number);
-            BFS(g, x - 1, y, min_color, player_number);
-            BFS(g, x, y - 1, min_color, player_number);
-            BFS(g, x, y + 1, min_color, player_number);
-     }
+    atomic_compare_exchange_strong_explicit(&arena->next, &next, offset,
+                                            memory_order_relaxed, memory_order_relaxed);
 }
 
-bool game_move(game_t* g, uint32_t player, uint32_t x, uint32_t y) {
-    if (!g || !correct_player_number(g, player) || !correct_coordinate(g, x, y) ||
-         g->game_board[x][y].player_number != 0) {
-            return false;
+game_allocator_t* game_arena_new(size_t size) {
+    if (size > SIZE_MAX - sizeof(arena_t)) {
+        return NULL;
     }
 
-    /**
-     * We split next part of that function on two cases:
-     * (1) the move is "boundary" i.e. adding the figure
-     * does not create new area,
-     * (2) the move creates new area.
-     */
-    update_structure(g, x, y);
+    arena_t* arena = malloc(sizeof(arena_t) + size);
 
-    if (!boundary_adding(g->diff_pair_neighbour, player)) {
-        if (player_occupied_all_areas(g, player)) {
-            return false;
-        }
+    if (!arena) {
+        return NULL;
+    }
 
-        // Update current player.
-        g->all_players[player - 1].busy_areas++;
-        g->all_players[player - 1].busy_fields++;
-        g->all_players[player - 1].boundary_length += g->potential_neighbour_number -
-                                                      g->busy_neighbour_fields -
-                                                      check_non_direct_neighbours(g, x, y, player);
+    arena->allocator.allocate = arena_allocate;
+    arena->allocator.deallocate = arena_deallocate;
+    arena->allocator.context = arena;
+    arena->allocator.budget = 0;
+    atomic_init(&arena->next, 0);
+    arena->size = size;
 
-        // Update the game structure and the GLOBAL_COUNTER.
-        g->game_board[x][y].player_number = player;
-        g->game_board[x][y].color = GLOBAL_COUNTER;
-        GLOBAL_COUNTER++;
-        g->fields_to_take--;
+    return &arena->allocator;
+}
 
-        // Update all non empty diff_pair_neighbour.
-        uint32_t helper_variable;
+void game_arena_delete(game_allocator_t* arena) {
+    // The allocator is the first member of the arena.
+    free(arena);
+}
 
-        for (uint64_t i = 0; i < g->length_diff_neighbour_number; i++) {
-            helper_variable = g->diff_neighbour_number[i];
-            g->all_players[helper_variable - 1].boundary_length--;
-        }
+void game_delete(game_t* g) {
+    if (g) {
+        remove_struct(g);
     }
-    else {
-        uint64_t min_color = find_min_color(g, player);
-        uint32_t fragments = 0;
+}
 
-        // Firstly find the number of neighbours with the same number.
-        for (int i = 0; i < 4; i++) {
-            if (g->diff_pair_neighbour[i].player_number == player) {
-                fragments++;
-            }
-        }
+// Returns true if the player_number is correct and false otherwise.
+static bool correct_player_number(game_t const* g, uint32_t const player_number) {
+    return (!(player_number == 0 || player_number > g->number_of_players));
+}
+
+// Returns true if the player occupied all possible aries and false otherwise.
+static bool player_occupied_all_areas(game_t const* g, uint32_t const player_number) {
+    return (g->all_players[player_number - 1].busy_areas == g->max_areas);
+}
 
-        // Update me.
-        g->all_players[player - 1].busy_areas -= fragments - 1;
-        g->all_players[player - 1].busy_fields++;
-        g->all_players[player - 1].boundary_length += g->potential_neighbour_number -
-                                                      g->busy_neighbour_fields -
-                                                      check_non_direct_neighbours(g, x, y, player);
+// Updates the bits of the player in full_players and bordered_players
+// after a change of his busy_areas or boundary_length. In the concurrent
+// mode the masks are computed when it ends.
+static void update_player_masks(game_t* g, uint32_t const player_number) {
+    if (g->concurrency) {
+        return;
+    }
 
-        // Update the game structure and the GLOBAL_COUNTER.
-        g->game_board[x][y].player_number = player;
-        g->game_board[x][y].color = min_color;
-        GLOBAL_COUNTER++;
-        g->fields_to_take--;
+    uint64_t bit = 1ULL << (player_number - 1);
+    player_t const* player = &g->all_players[player_number - 1];
 
-        // Update all diff_pair_neighbour with different figures.
-        int z = 0;
-        uint32_t local_number; // Helper in next while loop.
+    g->full_players = player->busy_areas == g->max_areas ? g->full_players | bit :
+                                                          g->full_players & ~bit;
+    g->bordered_players = player->boundary_length > 0 ? g->bordered_players | bit :
+                                                       g->bordered_players & ~bit;
+}
 
-        while (z < 4 && g->diff_neighbour_number[z] != 0) {
-            local_number = g->diff_neighbour_number[z];
-            g->all_players[local_number - 1].boundary_length--;
+// Returns the mask of the players who can make a move, the bit p - 1 is set
+// if game_free_fields of the player p is positive. MAX_PLAYERS is less than
+// 64, so all players fit in the mask.
+static uint64_t movable_players(game_t const* g) {
+    uint64_t all = (1ULL << g->number_of_players) - 1;
+    uint64_t not_full = g->fields_to_take > 0 ? all & ~g->full_players : 0;
 
-            z++;
-        }
+    return (g->full_players & g->bordered_players) | not_full;
+}
 
-        // Update all diff_pair_neighbour with the same number by recoloring them.
-        BFS(g, x + 1, y, min_color, player);
-        BFS(g, x - 1, y, min_color, player);
-        BFS(g, x, y - 1, min_color, player);
-        BFS(g, x, y + 1, min_color, player);
-    }
+// Returns the Zobrist key of the field with the index taken by the player.
+// A board may have more fields than fit in memory, so instead of a table
+// of random keys the keys are computed by the finalizer of splitmix64.
+static uint64_t zobrist_key(uint64_t const index, uint32_t const player) {
+    uint64_t key = (index ^ ((uint64_t)player << 58)) + 0x9E3779B97F4A7C15ULL * player;
 
-    set_to_zero(g);
+    key = (key ^ (key >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    key = (key ^ (key >> 27)) * 0x94D049BB133111EBULL;
 
-    return true;
+    return key ^ (key >> 31);
 }
 
-uint64_t game_busy_fields(game_t const* g, uint32_t player) {
-    if (!g || !correct_player_number(g, player)) {
-        return 0;
-    }
-
-    return g->all_players[player - 1].busy_fields;
+// Returns true if the coordinate is valid and false otherwise.
+static bool correct_coordinate(game_t const* g, uint32_t const x, uint32_t const y) {
+    return (!(x >= g->width || y >= g->height));
 }
 
-uint64_t game_free_fields(game_t const* g, uint32_t player) {
-    if (!g || !correct_player_number(g, player)) {
-        return 0;
-    }
-    if (player_occupied_all_areas(g, player)) {
-        return g->all_players[player - 1].boundary_length;
-    }
+// Returns the index of the coordinate (x,y) in game_board.
+static uint64_t field_index(game_t const* g, uint32_t const x, uint32_t const y) {
+    return (uint64_t)x * (uint64_t)g->height + (uint64_t)y;
+}
 
-    return g->fields_to_take;
+// Returns the number of the tile containing the field (x,y).
+static uint64_t tile_number(game_t const* g, uint32_t const x, uint32_t const y) {
+    return (uint64_t)(x >> TILE_SHIFT) * g->tiles_height + (y >> TILE_SHIFT);
 }
 
-uint64_t game_general_free_fields(game_t const* g) {
-    return g->fields_to_take;
+// Returns the index of the field (x,y) in its tile.
+static uint32_t tile_index(uint32_t const x, uint32_t const y) {
+    return ((x & TILE_MASK) << TILE_SHIFT) | (y & TILE_MASK);
 }
 
-uint32_t game_board_width(game_t const *g) {
-    if (!g) {
-        return 0;
-    }
+// Returns the tile containing the field (x,y) or NULL if all fields
+// of that tile are free.
+static tile_t* find_tile(game_t const* g, uint32_t const x, uint32_t const y) {
+    uint64_t number = tile_number(g, x, y);
+    directory_t const* directory = g->directories[number >> DIRECTORY_SHIFT];
 
-    return g->width;
+    return directory ? directory->tiles[number & DIRECTORY_MASK] : NULL;
 }
 
-uint32_t game_board_height(game_t const *g) {
-    if (!g) {
-        return 0;
-    }
+// Returns the player numbers of the tile (of all fields of a dense tile
+// and of the busy fields of a sparse one).
+static uint8_t* tile_players(tile_t const* tile) {
+    uint32_t colors = tile->length == TILE_DENSE ? TILE_FIELDS : TILE_SPARSE_FIELDS;
 
-    return g->height;
+    return (uint8_t*)(tile->colors + colors) +
+           (tile->length == TILE_DENSE ? 0 : TILE_SPARSE_FIELDS * sizeof(uint16_t));
 }
 
-uint32_t game_areas(game_t const* g) {
-    return g->max_areas;
+// Returns the indices of the busy fields of the sparse tile.
+static uint16_t* sparse_indices(tile_t const* tile) {
+    return (uint16_t*)(tile->colors + TILE_SPARSE_FIELDS);
 }
 
-uint32_t game_players(game_t const *g) {
-    if (!g) {
-        return 0;
+// Returns the position of the field with the index in the sparse tile
+// or the length of the tile if that field is free.
+static uint32_t sparse_position(tile_t const* tile, uint32_t const index) {
+    uint16_t const* indices = sparse_indices(tile);
+    uint32_t position = 0;
+
+    while (position < tile->length && indices[position] != index) {
+        position++;
     }
 
-    return g->number_of_players;
+    return position;
 }
 
-char game_player(game_t const* g, uint32_t player) {
-    if (!g || !correct_player_number(g, player)) {
-        return '.';
+// Returns the player number of the field with the index in the tile.
+static uint32_t tile_player(tile_t const* tile, uint32_t const index) {
+    if (tile->length == TILE_DENSE) {
+        return tile_players(tile)[index];
     }
 
-    return g->all_players[player - 1].player_symbol;
+    uint32_t position = sparse_position(tile, index);
+
+    return position < tile->length ? tile_players(tile)[position] : 0;
 }
 
-char* game_board(game_t const *g) {
-    if (!g) {
-        return NULL;
-    }
+// Sets the player number and the color of the field with the index in
+// the writable tile, the player number zero makes the field free. A sparse
+// tile must have place for one more field (see writable_tile).
+static void set_tile_field(tile_t* tile, uint32_t const index, uint32_t const player,
+                           uint64_t const color) {
+    uint8_t* players = tile_players(tile);
 
-    uint64_t size = ((uint64_t)g->width + 1) * (uint64_t )g->height + 1;
-    char* board = (char*)malloc(size * sizeof(char));
-    uint64_t local_index = 0;
-    uint32_t player_number;
+    if (tile->length == TILE_DENSE) {
+        players[index] = (uint8_t)player;
+        tile->colors[index] = color;
 
-    if (!board) {
-      return NULL;
+        return;
     }
 
-    for (uint32_t i = g->height; i-- > 0;) {
-        for (uint32_t j = 0; j < g->width; j++) {
-            player_number = g->game_board[j][i].player_number;
+    uint16_t* indices = sparse_indices(tile);
+    uint32_t position = sparse_position(tile, index);
 
-            if (player_number == 0) {
-                board[local_index] = '.';
+    if (player == 0) {
+        // The last field takes the place of the freed one.
+        if (position < tile->length) {
+            tile->length--;
+            indices[position] = indices[tile->length];
+            players[position] = players[tile->length];
+            tile->colors[position] = tile->colors[tile->length];
+        }
+
+        return;
+    }
+
+    if (position == tile->length) {
+        indices[position] = (uint16_t)index;
+        tile->length++;
+    }
+
+    players[position] = (uint8_t)player;
+    tile->colors[position] = color;
+}
+
+// Returns true if the next move in the tile needs a dense tile.
+static bool tile_full(tile_t const* tile) {
+    return tile->length == TILE_SPARSE_FIELDS;
+}
+
+// Returns the player number of the field (x,y) or zero if that field is free.
+static uint32_t field_player(game_t const* g, uint32_t const x, uint32_t const y) {
+    tile_t const* tile = find_tile(g, x, y);
+
+    return tile ? tile_player(tile, tile_index(x, y)) : 0;
+}
+
+// Returns the player number and the color of the busy field (x,y).
+static pair_t field_pair(game_t const* g, uint32_t const x, uint32_t const y) {
+    tile_t const* tile = find_tile(g, x, y);
+    uint32_t index = tile_index(x, y);
+    uint32_t position = tile->length == TILE_DENSE ? index : sparse_position(tile, index);
+    pair_t answer = {
+        .color = tile->colors[position],
+        .player_number = tile_players(tile)[position]
+    };
+
+    return answer;
+}
+
+// Makes the directory with the given number exclusive to the game,
+// allocating or copying it if needed. Returns NULL and sets errno
+// to ENOMEM if the allocation failed.
+static directory_t* writable_directory(game_t* g, uint64_t const number) {
+    directory_t* directory = g->directories[number];
+
+    if (directory && exclusive(&directory->references)) {
+        return directory;
+    }
+
+    directory_t* copy = heap_allocate(g->heap, sizeof(directory_t), !directory);
+
+    if (!copy) {
+        return NULL;
+    }
+
+    if (directory) {
+        memcpy(copy->tiles, directory->tiles, sizeof(copy->tiles));
+
+        for (uint32_t i = 0; i < DIRECTORY_TILES; i++) {
+            if (copy->tiles[i]) {
+                share(&copy->tiles[i]->references);
+            }
+        }
+
+        release_directory(g, directory);
+    }
+    else {
+        g->allocated_directories++;
+    }
+
+    atomic_init(&copy->references, 1);
+    g->directories[number] = copy;
+
+    return copy;
+}
+
+// Adds a tile to the counter of tiles. In the concurrent mode the tiles
+// are counted when it ends.
+static void count_tile(game_t* g, uint64_t* counter) {
+    if (!g->concurrency) {
+        (*counter)++;
+    }
+}
+
+// Makes the tile containing the field (x,y) exclusive to the game and
+// able to take one more field, allocating, copying or making it dense
+// if needed. Returns NULL and sets errno to ENOMEM if the allocation failed.
+static tile_t* writable_tile(game_t* g, uint32_t const x, uint32_t const y) {
+    uint64_t number = tile_number(g, x, y);
+    directory_t* directory = writable_directory(g, number >> DIRECTORY_SHIFT);
+
+    if (!directory) {
+        return NULL;
+    }
+
+    tile_t* tile = directory->tiles[number & DIRECTORY_MASK];
+
+    if (tile && exclusive(&tile->references) && !tile_full(tile)) {
+        return tile;
+    }
+
+    bool dense = tile && (tile->length == TILE_DENSE || tile_full(tile));
+    uint64_t size = dense ? DENSE_TILE_SIZE : SPARSE_TILE_SIZE;
+    tile_t* copy = heap_allocate(g->heap, size, false);
+
+    if (!copy) {
+        return NULL;
+    }
+
+    if (!tile) {
+        copy->length = 0;
+        count_tile(g, &g->allocated_tiles);
+    }
+    else if (tile->length != TILE_DENSE && dense) {
+        uint16_t const* indices = sparse_indices(tile);
+        uint8_t const* players = tile_players(tile);
+
+        copy->length = TILE_DENSE;
+        memset(tile_players(copy), 0, TILE_FIELDS);
+
+        for (uint32_t i = 0; i < tile->length; i++) {
+            tile_players(copy)[indices[i]] = players[i];
+            copy->colors[indices[i]] = tile->colors[i];
+        }
+
+        count_tile(g, &g->dense_tiles);
+    }
+    else {
+        memcpy(copy->colors, tile->colors, size - sizeof(tile_t));
+        copy->length = tile->length;
+    }
+
+    if (tile) {
+        release_tile(g, tile);
+    }
+
+    atomic_init(&copy->references, 1);
+    directory->tiles[number & DIRECTORY_MASK] = copy;
+
+    return copy;
+}
+
+// Returns true if the coordinate (x,y) is already occupied and false otherwise.
+static bool empty_coordinate(game_t const* g, uint32_t const x, uint32_t const y) {
+    return (field_player(g, x, y) == 0);
+}
+
+// Returns the block of the disjoint-set forest containing the color.
+static area_block_t* area_block(game_t const* g, uint64_t const color) {
+    return g->area_blocks[color >> AREA_BLOCK_SHIFT];
+}
+
+// Returns the parent of the color in the disjoint-set forest.
+static uint64_t area_parent(game_t const* g, uint64_t const color) {
+    return area_block(g, color)->parent[color & AREA_BLOCK_MASK];
+}
+
+// Returns the representative of the area with the given color without
+// changing the disjoint-set forest, so it may be called by many threads.
+static uint64_t area_root(game_t const* g, uint64_t color) {
+    while (area_parent(g, color) != color) {
+        color = area_parent(g, color);
+    }
+
+    return color;
+}
+
+// Returns the representative of the area with the given color. Compresses
+// the path, so every visited color points directly to the representative,
+// unless the journal is on. Shared blocks are not compressed.
+static uint64_t find_area(game_t* g, uint64_t color) {
+    uint64_t root = color;
+
+    COUNT(g, area_finds);
+
+    while (area_parent(g, root) != root) {
+        root = area_parent(g, root);
+        COUNT(g, area_find_steps);
+    }
+
+    if (g->journal_enabled) {
+        return root;
+    }
+
+    while (color != root) {
+        area_block_t* block = area_block(g, color);
+        uint64_t next = block->parent[color & AREA_BLOCK_MASK];
+
+        if (exclusive(&block->references)) {
+            block->parent[color & AREA_BLOCK_MASK] = root;
+        }
+
+        color = next;
+    }
+
+    return root;
+}
+
+// Joins two areas given by their representatives (union by size) and
+// returns the representative of the joined area. The blocks of both
+// representatives must be writable.
+static uint64_t union_areas(game_t* g, uint64_t first, uint64_t second) {
+    if (first == second) {
+        return first;
+    }
+
+    area_block_t* first_block = area_block(g, first);
+    area_block_t* second_block = area_block(g, second);
+
+    if (first_block->size[first & AREA_BLOCK_MASK] <
+        second_block->size[second & AREA_BLOCK_MASK]) {
+        uint64_t tmp = first;
+        first = second;
+        second = tmp;
+        first_block = area_block(g, first);
+        second_block = area_block(g, second);
+    }
+
+    COUNT(g, area_unions);
+    second_block->parent[second & AREA_BLOCK_MASK] = first;
+    first_block->size[first & AREA_BLOCK_MASK] += second_block->size[second & AREA_BLOCK_MASK];
+
+    if (g->journal_enabled) {
+        g->journal[g->journal_length++] = second;
+        g->journal[g->journal_length++] = first;
+    }
+
+    return first;
+}
+
+// Makes the block of the disjoint-set forest containing the color
+// exclusive to the game, allocating or copying it if needed. Returns false
+// and sets errno to ENOMEM if the allocation failed.
+static bool writable_area_block(game_t* g, uint64_t const color) {
+    uint64_t number = color >> AREA_BLOCK_SHIFT;
+
+    if (number >= g->number_of_area_blocks) {
+        uint64_t capacity = g->number_of_area_blocks == 0 ? INITIAL_CAPACITY :
+                            g->number_of_area_blocks;
+
+        while (capacity <= number) {
+            capacity *= 2;
+        }
+
+        area_block_t** area_blocks = heap_reallocate(g->heap, g->area_blocks,
+                                                     g->number_of_area_blocks *
+                                                     sizeof(area_block_t*),
+                                                     capacity * sizeof(area_block_t*));
+
+        if (!area_blocks) {
+            return false;
+        }
+
+        memset(area_blocks + g->number_of_area_blocks, 0,
+               (capacity - g->number_of_area_blocks) * sizeof(area_block_t*));
+        g->area_blocks = area_blocks;
+        g->number_of_area_blocks = capacity;
+    }
+
+    area_block_t* block = g->area_blocks[number];
+
+    if (block && exclusive(&block->references)) {
+        return true;
+    }
+
+    // A new block is cleared, the colors not given yet have the size zero
+    // (see correct_area_block).
+    area_block_t* copy = heap_allocate(g->heap, sizeof(area_block_t), !block);
+
+    if (!copy) {
+        return false;
+    }
+
+    if (block) {
+        memcpy(copy->parent, block->parent, sizeof(copy->parent));
+        memcpy(copy->size, block->size, sizeof(copy->size));
+        release_area_block(g, block);
+    }
+    else {
+        g->allocated_area_blocks++;
+    }
+
+    atomic_init(&copy->references, 1);
+    g->area_blocks[number] = copy;
+
+    return true;
+}
+
+// Makes sure that the array of words has place for the next count words.
+// Returns false and sets errno to ENOMEM if it cannot be enlarged.
+static bool reserve_words(heap_t* heap, uint64_t** words, uint64_t* capacity,
+                          uint64_t length, uint64_t count) {
+    if (length + count <= *capacity) {
+        return true;
+    }
+
+    uint64_t new_capacity = *capacity == 0 ? INITIAL_CAPACITY : *capacity;
+
+    while (new_capacity < length + count) {
+        new_capacity *= 2;
+    }
+
+    uint64_t* new_words = heap_reallocate(heap, *words, *capacity * sizeof(uint64_t),
+                                          new_capacity * sizeof(uint64_t));
+
+    if (!new_words) {
+        return false;
+    }
+
+    *words = new_words;
+    *capacity = new_capacity;
+
+    return true;
+}
+
+// Returns the first slot of the field index in a frontier with the given capacity.
+// Groups of TILE_SIDE consecutive indices (fields of one column) keep their
+// order, so neighbours in a column usually share a cache line.
+static uint64_t frontier_slot(uint64_t const capacity, uint64_t const index) {
+    uint64_t group = ((index >> TILE_SHIFT) * 0x9E3779B97F4A7C15ULL) >> 32;
+
+    return ((group << TILE_SHIFT) | (index & TILE_MASK)) & (capacity - 1);
+}
+
+// Adds the field index to the frontier, which has a free slot.
+static void frontier_insert(frontier_t* frontier, uint64_t const index) {
+    uint64_t mask = frontier->capacity - 1;
+    uint64_t slot = frontier_slot(frontier->capacity, index);
+
+    while (frontier->fields[slot] != FRONTIER_EMPTY) {
+        if (frontier->fields[slot] == index) {
+            return;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    frontier->fields[slot] = index;
+    frontier->length++;
+}
+
+// Returns true if the field index is in the frontier.
+static bool frontier_contains(frontier_t const* frontier, uint64_t const index) {
+    uint64_t mask = frontier->capacity - 1;
+
+    for (uint64_t slot = frontier_slot(frontier->capacity, index);
+         frontier->fields[slot] != FRONTIER_EMPTY; slot = (slot + 1) & mask) {
+        if (frontier->fields[slot] == index) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Removes the field index from the frontier, if it is there. The next
+// fields of the probe sequence are shifted back, so no slot is marked
+// as deleted.
+static void frontier_remove(frontier_t* frontier, uint64_t const index) {
+    uint64_t mask = frontier->capacity - 1;
+    uint64_t slot = frontier_slot(frontier->capacity, index);
+
+    while (frontier->fields[slot] != index) {
+        if (frontier->fields[slot] == FRONTIER_EMPTY) {
+            return;
+        }
+
+        slot = (slot + 1) & mask;
+    }
+
+    uint64_t hole = slot;
+
+    for (slot = (slot + 1) & mask; frontier->fields[slot] != FRONTIER_EMPTY;
+         slot = (slot + 1) & mask) {
+        uint64_t home = frontier_slot(frontier->capacity, frontier->fields[slot]);
+
+        // The field may fill the hole if the hole lies between its first
+        // slot and its current slot.
+        if (((slot - home) & mask) >= ((slot - hole) & mask)) {
+            frontier->fields[hole] = frontier->fields[slot];
+            hole = slot;
+        }
+    }
+
+    frontier->fields[hole] = FRONTIER_EMPTY;
+    frontier->length--;
+}
+
+// Makes the frontier of the player exclusive to the game with place for
+// the next extra fields, allocating, copying or enlarging it if needed.
+// Returns false and sets errno to ENOMEM if the allocation failed.
+static bool writable_frontier(game_t* g, uint32_t const player, uint64_t const extra) {
+    frontier_t* frontier = g->frontiers[player - 1];
+    uint64_t length = frontier ? frontier->length : 0;
+    uint64_t capacity = frontier ? frontier->capacity : INITIAL_CAPACITY;
+
+    // The set is kept at most three quarters full.
+    while (4 * (length + extra) > 3 * capacity) {
+        capacity *= 2;
+    }
+
+    if (frontier && exclusive(&frontier->references) && capacity == frontier->capacity) {
+        return true;
+    }
+
+    frontier_t* copy = heap_allocate(g->heap, sizeof(frontier_t) + capacity * sizeof(uint64_t),
+                                     false);
+
+    if (!copy) {
+        return false;
+    }
+
+    atomic_init(&copy->references, 1);
+    copy->capacity = capacity;
+    copy->length = 0;
+
+    for (uint64_t i = 0; i < capacity; i++) {
+        copy->fields[i] = FRONTIER_EMPTY;
+    }
+
+    if (frontier) {
+        if (capacity == frontier->capacity) {
+            memcpy(copy->fields, frontier->fields, capacity * sizeof(uint64_t));
+            copy->length = frontier->length;
+        }
+        else {
+            for (uint64_t i = 0; i < frontier->capacity; i++) {
+                if (frontier->fields[i] != FRONTIER_EMPTY) {
+                    frontier_insert(copy, frontier->fields[i]);
+                }
+            }
+        }
+
+        release_frontier(g, frontier);
+    }
+
+    g->frontiers[player - 1] = copy;
+
+    return true;
+}
+
+// Makes the bitplane with the given number (zero for the occupancy plane,
+// otherwise the player number) exclusive to the game, allocating or copying
+// it if needed. Returns false and sets errno to ENOMEM if the allocation failed.
+static bool writable_plane(game_t* g, uint32_t const number) {
+    bitplane_t* plane = g->planes[number];
+
+    if (plane && exclusive(&plane->references)) {
+        return true;
+    }
+
+    bitplane_t* copy = heap_allocate(g->heap, plane_size(g), false);
+
+    if (!copy) {
+        return false;
+    }
+
+    if (plane) {
+        memcpy(copy->words, plane->words, g->plane_words * sizeof(uint64_t));
+        release_plane(g, plane);
+    }
+    else {
+        memset(copy->words, 0, g->plane_words * sizeof(uint64_t));
+    }
+
+    atomic_init(&copy->references, 1);
+    g->planes[number] = copy;
+
+    return true;
+}
+
+// Returns the index of the word of a bitplane containing the field (x,y).
+static uint64_t plane_word(game_t const* g, uint32_t const x, uint32_t const y) {
+    return ((uint64_t)x + 1) * g->plane_stride + 1 + (y >> 6);
+}
+
+// Writes count words of the frontier of a column: the free fields (not set
+// in occupied) with a neighbour set in the plane. The pointers point to
+// the first word in the previous, the same and the next column of the plane.
+static void frontier_words_scalar(uint64_t const* left, uint64_t const* column,
+                                  uint64_t const* right, uint64_t const* occupied,
+                                  uint64_t* frontier, uint64_t count) {
+    for (uint64_t i = 0; i < count; i++) {
+        uint64_t neighbours = left[i] | right[i] | (column[i] << 1) | (column[i] >> 1) |
+                              (column[i - 1] >> 63) | (column[i + 1] << 63);
+
+        frontier[i] = neighbours & ~occupied[i];
+    }
+}
+
+#ifdef BITPLANE_AVX2
+// The same as frontier_words_scalar, four words at once.
+__attribute__((target("avx2")))
+static void frontier_words_avx2(uint64_t const* left, uint64_t const* column,
+                                uint64_t const* right, uint64_t const* occupied,
+                                uint64_t* frontier, uint64_t count) {
+    uint64_t i = 0;
+
+    for (; i + 4 <= count; i += 4) {
+        __m256i middle = _mm256_loadu_si256((__m256i const*)(column + i));
+        __m256i above = _mm256_loadu_si256((__m256i const*)(column + i - 1));
+        __m256i below = _mm256_loadu_si256((__m256i const*)(column + i + 1));
+        __m256i neighbours = _mm256_or_si256(
+            _mm256_or_si256(_mm256_loadu_si256((__m256i const*)(left + i)),
+                            _mm256_loadu_si256((__m256i const*)(right + i))),
+            _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi64(middle, 1),
+                                            _mm256_srli_epi64(middle, 1)),
+                            _mm256_or_si256(_mm256_srli_epi64(above, 63),
+                                            _mm256_slli_epi64(below, 63))));
+        __m256i free_fields = _mm256_loadu_si256((__m256i const*)(occupied + i));
+
+        _mm256_storeu_si256((__m256i*)(frontier + i),
+                            _mm256_andnot_si256(free_fields, neighbours));
+    }
+
+    frontier_words_scalar(left + i, column + i, right + i, occupied + i,
+                          frontier + i, count - i);
+}
+#endif
+
+// Computes the words [first, first + count) of the frontier of the column x
+// of the player, who has a bitplane.
+static void frontier_words(game_t const* g, uint32_t player, uint32_t x,
+                           uint64_t first, uint64_t count, uint64_t* frontier) {
+    uint64_t start = ((uint64_t)x + 1) * g->plane_stride + 1 + first;
+    uint64_t const* plane = g->planes[player]->words;
+    uint64_t const* occupied = g->planes[0]->words;
+
+#ifdef BITPLANE_AVX2
+    if (__builtin_cpu_supports("avx2")) {
+        frontier_words_avx2(plane + start - g->plane_stride, plane + start,
+                            plane + start + g->plane_stride, occupied + start,
+                            frontier, count);
+        return;
+    }
+#endif
+
+    frontier_words_scalar(plane + start - g->plane_stride, plane + start,
+                          plane + start + g->plane_stride, occupied + start,
+                          frontier, count);
+}
+
+// Returns the player number of the field (x + dx, y + dy) of the stencil.
+static uint32_t stencil_player(stencil_t const* stencil, int const dx, int const dy) {
+    return stencil->players[STENCIL_RADIUS + dx][STENCIL_RADIUS + dy];
+}
+
+// Fills the stencil of the field (x,y) lying with all fields of the stencil
+// in the given tile, a dense tile is read directly and a sparse one
+// in one scan of its busy fields. All fields of a NULL tile are free.
+static void gather_tile_stencil(tile_t const* tile, uint32_t const x, uint32_t const y,
+                                stencil_t* stencil) {
+    if (!tile) {
+        memset(stencil->players, 0, sizeof(stencil->players));
+
+        return;
+    }
+
+    uint8_t const* players = tile_players(tile);
+    int const index = (int)tile_index(x, y);
+
+    if (tile->length == TILE_DENSE) {
+        for (int dx = -STENCIL_RADIUS; dx <= STENCIL_RADIUS; dx++) {
+            int reach = STENCIL_RADIUS - abs(dx);
+
+            for (int dy = -reach; dy <= reach; dy++) {
+                stencil->players[STENCIL_RADIUS + dx][STENCIL_RADIUS + dy] =
+                    players[index + dx * (int)TILE_SIDE + dy];
+            }
+        }
+
+        for (int i = 0; i < MAX_NEIGHBOURS; i++) {
+            int neighbour = index + neighbour_dx[i] * (int)TILE_SIDE + neighbour_dy[i];
+
+            stencil->colors[STENCIL_RADIUS + neighbour_dx[i]][STENCIL_RADIUS + neighbour_dy[i]] =
+                tile->colors[neighbour];
+        }
+
+        return;
+    }
+
+    uint16_t const* indices = sparse_indices(tile);
+
+    memset(stencil->players, 0, sizeof(stencil->players));
+
+    for (uint32_t i = 0; i < tile->length; i++) {
+        int dx = (int)(indices[i] >> TILE_SHIFT) - (index >> TILE_SHIFT);
+        int dy = (int)(indices[i] & TILE_MASK) - (index & (int)TILE_MASK);
+
+        if (abs(dx) + abs(dy) <= STENCIL_RADIUS) {
+            stencil->players[STENCIL_RADIUS + dx][STENCIL_RADIUS + dy] = players[i];
+            stencil->colors[STENCIL_RADIUS + dx][STENCIL_RADIUS + dy] = tile->colors[i];
+        }
+    }
+}
+
+// Fills the stencil of the field (x,y) reading its fields one by one,
+// only the fields inside the board are read.
+static void gather_border_stencil(game_t const* g, uint32_t const x, uint32_t const y,
+                                  stencil_t* stencil) {
+    // How far the stencil reaches in every direction without leaving the board.
+    int left = x < STENCIL_RADIUS ? (int)x : STENCIL_RADIUS;
+    int right = g->width - 1 - x < STENCIL_RADIUS ? (int)(g->width - 1 - x) : STENCIL_RADIUS;
+    int up = y < STENCIL_RADIUS ? (int)y : STENCIL_RADIUS;
+    int down = g->height - 1 - y < STENCIL_RADIUS ? (int)(g->height - 1 - y) : STENCIL_RADIUS;
+
+    memset(stencil->players, STENCIL_OUTSIDE, sizeof(stencil->players));
+
+    for (int dx = -left; dx <= right; dx++) {
+        int reach = STENCIL_RADIUS - abs(dx);
+
+        for (int dy = -reach; dy <= reach; dy++) {
+            if (dy < -up || dy > down) {
+                continue;
+            }
+
+            uint32_t player = field_player(g, x + dx, y + dy);
+
+            stencil->players[STENCIL_RADIUS + dx][STENCIL_RADIUS + dy] = (uint8_t)player;
+
+            if (player != 0 && abs(dx) + abs(dy) == 1) {
+                stencil->colors[STENCIL_RADIUS + dx][STENCIL_RADIUS + dy] =
+                    field_pair(g, x + dx, y + dy).color;
+            }
+        }
+    }
+}
+
+// Reads the stencil of the free field (x,y) of the given tile, which is
+// the whole part of the board game_move depends on.
+static void gather_stencil(game_t const* g, tile_t const* tile, uint32_t const x,
+                           uint32_t const y, stencil_t* stencil) {
+    // The fields of the tile with the whole stencil in that tile.
+    uint32_t const inner = TILE_SIDE - 2 * STENCIL_RADIUS;
+
+    if (((x & TILE_MASK) - STENCIL_RADIUS) < inner && ((y & TILE_MASK) - STENCIL_RADIUS) < inner &&
+        x + STENCIL_RADIUS < g->width && y + STENCIL_RADIUS < g->height) {
+        gather_tile_stencil(tile, x, y, stencil);
+    }
+    else {
+        gather_border_stencil(g, x, y, stencil);
+    }
+}
+
+// Writes to the array the different player numbers of the busy direct
+// neighbours of the field of the stencil and returns their number.
+static uint64_t neighbour_players(stencil_t const* stencil, uint32_t* players) {
+    uint64_t length = 0;
+
+    for (int i = 0; i < MAX_NEIGHBOURS; i++) {
+        uint32_t player = stencil_player(stencil, neighbour_dx[i], neighbour_dy[i]);
+        bool copy = player == 0 || player == STENCIL_OUTSIDE;
+
+        for (uint64_t z = 0; z < length && !copy; z++) {
+            copy = players[z] == player;
+        }
+
+        if (!copy) {
+            players[length++] = player;
+        }
+    }
+
+    return length;
+}
+
+// Reads the direct neighbours of the field of the stencil.
+static void read_neighbourhood(stencil_t const* stencil, neighbourhood_t* around) {
+    around->pairs_length = 0;
+    around->busy = 0;
+    around->potential = 0;
+
+    for (int i = 0; i < MAX_NEIGHBOURS; i++) {
+        uint32_t player = stencil_player(stencil, neighbour_dx[i], neighbour_dy[i]);
+
+        if (player == STENCIL_OUTSIDE) {
+            continue;
+        }
+
+        around->potential++;
+
+        if (player == 0) {
+            continue;
+        }
+
+        uint64_t color = stencil->colors[STENCIL_RADIUS + neighbour_dx[i]]
+                                        [STENCIL_RADIUS + neighbour_dy[i]];
+        bool copy = false;
+
+        around->busy++;
+
+        for (uint64_t z = 0; z < around->pairs_length && !copy; z++) {
+            copy = around->pairs[z].player_number == player && around->pairs[z].color == color;
+        }
+
+        if (!copy) {
+            around->pairs[around->pairs_length].color = color;
+            around->pairs[around->pairs_length].player_number = player;
+            around->pairs_length++;
+        }
+    }
+
+    around->players_length = neighbour_players(stencil, around->players);
+}
+
+/** @brief Checks if adding new figure joins it to an area of the player.
+ * @param[in] around          - the neighbours of the field,
+ * @param[in] player_number   - the player number.
+ * @return true if the field has a neighbour of the player (so no new area
+ * is created) and false otherwise.
+ */
+static bool boundary_adding(neighbourhood_t const* around, uint32_t const player_number) {
+    for (uint64_t i = 0; i < around->players_length; i++) {
+        if (around->players[i] == player_number) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// Returns the player number of the field (x + dx, y + dy) of the stencil
+// read while computing the boundary, counts the lookups of the fields
+// of the board (for game_stats_t).
+static uint32_t looked_up_player(stencil_t const* stencil, int const dx, int const dy,
+                                 uint64_t* lookups) {
+    uint32_t player = stencil_player(stencil, dx, dy);
+
+    *lookups += player != STENCIL_OUTSIDE;
+
+    return player;
+}
+
+/** @brief An auxilary function which analyses free neighbour cell
+ *  of the field c of the stencil and add +1 to the answer if that
+ *  field has its own neighbour (different that c) with the
+ *  same figure number as in c.
+ * @param[in] stencil         - the neighbourhood of c,
+ * @param[in] player_number   - the number of the figure we put at c,
+ * @param[in,out] lookups     - the counter of the read fields of the board.
+ * @return The number of free neighbours of c which have among their own
+ * neighbours the player_number.
+ */
+static uint64_t check_non_direct_neighbours(stencil_t const* stencil, uint32_t player_number,
+                                             uint64_t* lookups) {
+    uint64_t answer = 0;
+
+    for (int i = 0; i < MAX_NEIGHBOURS; i++) {
+        int dx = neighbour_dx[i];
+        int dy = neighbour_dy[i];
+
+        // The fields outside the board never have the player number.
+        if (looked_up_player(stencil, dx, dy, lookups) == 0 &&
+            (looked_up_player(stencil, 2 * dx, 2 * dy, lookups) == player_number ||
+             looked_up_player(stencil, dx + dy, dy + dx, lookups) == player_number ||
+             looked_up_player(stencil, dx - dy, dy - dx, lookups) == player_number)) {
+            answer++;
+        }
+    }
+
+    return answer;
+}
+
+// Returns true if the field (x,y) has a neighbour with the player number.
+static bool has_neighbour(game_t const* g, uint32_t x, uint32_t y, uint32_t player_number) {
+    return (correct_coordinate(g, x - 1, y) && field_player(g, x - 1, y) == player_number) ||
+           (correct_coordinate(g, x + 1, y) && field_player(g, x + 1, y) == player_number) ||
+           (correct_coordinate(g, x, y - 1) && field_player(g, x, y - 1) == player_number) ||
+           (correct_coordinate(g, x, y + 1) && field_player(g, x, y + 1) == player_number);
+}
+
+// Returns true if the free field (x,y) has a neighbour of the player, read
+// from the bitplane or the frontier of the player instead of the tiles.
+static bool touches_player(game_t const* g, uint32_t player, uint32_t x, uint32_t y) {
+    if (!g->planes) {
+        frontier_t const* frontier = g->frontiers[player - 1];
+
+        return frontier && frontier_contains(frontier, field_index(g, x, y));
+    }
+    if (!g->planes[player]) {
+        return false;
+    }
+
+    // The neighbours above and below may lie in the previous or the next
+    // word of the column, the guard words keep the edges zero.
+    uint64_t const* words = g->planes[player]->words + plane_word(g, x, y);
+    uint32_t bit = y & 63;
+    uint64_t sides = words[-(int64_t)g->plane_stride] | words[g->plane_stride];
+    uint64_t above = bit == 0 ? words[-1] >> 63 : words[0] >> (bit - 1);
+    uint64_t below = bit == 63 ? words[1] : words[0] >> (bit + 1);
+
+    return ((sides >> bit) | above | below) & 1;
+}
+
+// Makes writable the frontiers changed by the move of the player with
+// the given neighbours. Returns false if the allocation failed.
+static bool writable_frontiers(game_t* g, neighbourhood_t const* around, uint32_t player) {
+    // With bitplanes only the planes of the player and the occupancy change.
+    if (g->planes) {
+        return writable_plane(g, 0) && writable_plane(g, player);
+    }
+
+    if (!writable_frontier(g, player, MAX_NEIGHBOURS)) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < around->players_length; i++) {
+        if (around->players[i] != player && !writable_frontier(g, around->players[i], 0)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+
+// Updates the frontiers after the move of the player on the field (x,y):
+// the field leaves the frontiers of all its neighbours and its free
+// neighbours join the frontier of the player. With bitplanes the field
+// is only marked in the planes.
+static void update_frontiers(game_t* g, stencil_t const* stencil, neighbourhood_t const* around,
+                             uint32_t player, uint32_t x, uint32_t y) {
+    if (g->planes) {
+        g->planes[0]->words[plane_word(g, x, y)] |= 1ULL << (y & 63);
+        g->planes[player]->words[plane_word(g, x, y)] |= 1ULL << (y & 63);
+
+        return;
+    }
+
+    uint64_t index = field_index(g, x, y);
+    frontier_t* frontier = g->frontiers[player - 1];
+
+    for (uint64_t i = 0; i < around->players_length; i++) {
+        frontier_remove(g->frontiers[around->players[i] - 1], index);
+    }
+
+    for (int i = 0; i < MAX_NEIGHBOURS; i++) {
+        if (stencil_player(stencil, neighbour_dx[i], neighbour_dy[i]) == 0) {
+            frontier_insert(frontier, field_index(g, x + neighbour_dx[i], y + neighbour_dy[i]));
+        }
+    }
+}
+
+// Removes the free field (x,y) from the frontier of the player if it is
+// valid and has no neighbour of that player.
+static void remove_from_frontier(game_t const* g, uint32_t player, uint32_t x, uint32_t y) {
+    if (correct_coordinate(g, x, y) && empty_coordinate(g, x, y) &&
+        !has_neighbour(g, x, y, player)) {
+        frontier_remove(g->frontiers[player - 1], field_index(g, x, y));
+    }
+}
+
+// Appends the record of the move of the player on the field (x,y) with
+// the given neighbours to the journal (the unions are already there).
+static void journal_move(game_t* g, neighbourhood_t const* around, uint32_t x, uint32_t y,
+                         uint32_t player, bool new_area, uint32_t unions, uint64_t boundary) {
+    uint64_t description = player | ((uint64_t)unions << JOURNAL_UNIONS) |
+                           (boundary << JOURNAL_BOUNDARY) |
+                           (around->players_length << JOURNAL_NEIGHBOURS);
+
+    if (new_area) {
+        description |= JOURNAL_NEW_AREA;
+    }
+
+    for (uint64_t i = 0; i < around->players_length; i++) {
+        description |= (uint64_t)around->players[i] << (JOURNAL_NEIGHBOUR + 8 * i);
+    }
+
+    g->journal[g->journal_length++] = field_index(g, x, y);
+    g->journal[g->journal_length++] = description;
+}
+
+// Takes the locks of the players in the mask (the bit p - 1 stands for
+// the player p) in the increasing order of their numbers. Does nothing
+// outside the concurrent mode.
+static void lock_players(game_t* g, uint64_t players) {
+    for (; g->concurrency && players != 0; players &= players - 1) {
+        pthread_mutex_lock(&g->concurrency->players[__builtin_ctzll(players)].lock);
+    }
+}
+
+// Releases the locks taken by lock_players.
+static void unlock_players(game_t* g, uint64_t players) {
+    for (; g->concurrency && players != 0; players &= players - 1) {
+        pthread_mutex_unlock(&g->concurrency->players[__builtin_ctzll(players)].lock);
+    }
+}
+
+// Takes the lock of the disjoint-set forest in the concurrent mode.
+static void lock_forest(game_t* g) {
+    if (g->concurrency) {
+        pthread_mutex_lock(&g->concurrency->forest);
+    }
+}
+
+static void unlock_forest(game_t* g) {
+    if (g->concurrency) {
+        pthread_mutex_unlock(&g->concurrency->forest);
+    }
+}
+
+// Joins the areas of the player neighbouring the field into one area.
+// Writes its color and the number of the joined areas. A field next to one
+// color of the player takes that color without looking into the forest.
+// Returns false if the allocation failed, then no area is joined.
+static bool join_areas(game_t* g, neighbourhood_t const* around, uint32_t player,
+                       uint64_t* color, uint32_t* fragments) {
+    uint64_t roots[MAX_NEIGHBOURS];
+    uint32_t length = 0;
+
+    for (uint64_t i = 0; i < around->pairs_length; i++) {
+        if (around->pairs[i].player_number == player) {
+            roots[length++] = around->pairs[i].color;
+        }
+    }
+
+    if (length == 1) {
+        *color = roots[0];
+        *fragments = 1;
+
+        return true;
+    }
+
+    lock_forest(g);
+
+    uint32_t different = 0;
+
+    for (uint32_t i = 0; i < length; i++) {
+        uint64_t root = find_area(g, roots[i]);
+        bool copy = false;
+
+        for (uint32_t z = 0; z < different && !copy; z++) {
+            copy = roots[z] == root;
+        }
+
+        if (!copy) {
+            roots[different++] = root;
+        }
+    }
+
+    // The joined areas are modified, so they can not be shared.
+    for (uint32_t i = 0; i < different; i++) {
+        if (!writable_area_block(g, roots[i])) {
+            unlock_forest(g);
+
+            return false;
+        }
+    }
+
+    *color = roots[0];
+
+    for (uint32_t i = 1; i < different; i++) {
+        *color = union_areas(g, *color, roots[i]);
+    }
+
+    unlock_forest(g);
+    *fragments = different;
+
+    return true;
+}
+
+// Takes the color of a new area of the player and makes it the representative
+// of that area. In the concurrent mode the color comes from the range reserved
+// by the player, a new range (the rest of the block of next_color) is reserved
+// under the lock of the forest. Returns false if the allocation failed.
+static bool new_area_color(game_t* g, uint32_t player, uint64_t* color) {
+    area_block_t* block;
+
+    if (!g->concurrency) {
+        if (!writable_area_block(g, g->next_color)) {
+            return false;
+        }
+
+        *color = g->next_color++;
+        block = area_block(g, *color);
+    }
+    else {
+        player_lock_t* me = &g->concurrency->players[player - 1];
+
+        if (me->next_color == me->colors_end) {
+            lock_forest(g);
+
+            bool reserved = writable_area_block(g, g->next_color);
+
+            if (reserved) {
+                me->next_color = g->next_color;
+                me->colors_end = (g->next_color | AREA_BLOCK_MASK) + 1;
+                me->block = area_block(g, g->next_color);
+                g->next_color = me->colors_end;
+            }
+
+            unlock_forest(g);
+
+            if (!reserved) {
+                return false;
+            }
+        }
+
+        *color = me->next_color++;
+        block = me->block;
+    }
+
+    block->parent[*color & AREA_BLOCK_MASK] = *color;
+    block->size[*color & AREA_BLOCK_MASK] = 1;
+
+    return true;
+}
+
+// Makes the move of the valid player on the free field (x,y) of the given
+// writable tile, with the stencil and the neighbours of the field already
+// read. In the concurrent mode the caller holds the locks of the player
+// and of the players of the neighbours.
+static bool place_figure(game_t* g, tile_t* tile, stencil_t const* stencil,
+                         neighbourhood_t const* around, uint32_t player, uint32_t x,
+                         uint32_t y) {
+    /**
+     * We split next part of that function on two cases:
+     * (1) the move is "boundary" i.e. adding the figure
+     * does not create new area,
+     * (2) the move creates new area.
+     */
+    bool new_area = !boundary_adding(around, player);
+    uint32_t fragments = 0;
+    uint64_t color;
+
+    if (new_area && player_occupied_all_areas(g, player)) {
+        COUNT(g, rejected_areas);
+
+        return false;
+    }
+
+    // The color is taken last, so a rejected move does not use it.
+    if (!writable_frontiers(g, around, player) ||
+        !(new_area ? new_area_color(g, player, &color) :
+                     join_areas(g, around, player, &color, &fragments))) {
+        COUNT(g, rejected_memory);
+
+        return false;
+    }
+
+    uint64_t lookups = 0;
+    uint64_t boundary = around->potential - around->busy -
+                        check_non_direct_neighbours(stencil, player, &lookups);
+    player_t* me = &g->all_players[player - 1];
+
+    COUNT_ADD(g, neighbour_lookups, lookups);
+
+    // Update current player, a new area has no fragments.
+    me->busy_areas = me->busy_areas + 1 - fragments;
+    me->busy_fields++;
+    me->boundary_length += boundary;
+    set_tile_field(tile, tile_index(x, y), player, color);
+
+    // Every neighbour player loses the taken field from his boundary.
+    for (uint64_t i = 0; i < around->players_length; i++) {
+        g->all_players[around->players[i] - 1].boundary_length--;
+        update_player_masks(g, around->players[i]);
+    }
+
+    update_player_masks(g, player);
+    update_frontiers(g, stencil, around, player, x, y);
+
+    if (g->journal_enabled) {
+        journal_move(g, around, x, y, player, new_area, new_area ? 0 : fragments - 1, boundary);
+    }
+
+    if (new_area) {
+        COUNT(g, new_area_moves);
+    }
+    else {
+        COUNT(g, boundary_moves);
+    }
+
+    if (g->concurrency) {
+        g->concurrency->players[player - 1].hash ^= zobrist_key(field_index(g, x, y), player);
+    }
+    else {
+        g->fields_to_take--;
+        g->hash ^= zobrist_key(field_index(g, x, y), player);
+    }
+
+    return true;
+}
+
+// Makes the move of the valid player on the free field (x,y) of the given
+// writable tile, see game_move. In the concurrent mode the caller holds
+// the locks of the regions of the stencil of the field.
+static bool put_figure(game_t* g, tile_t* tile, uint32_t player, uint32_t x, uint32_t y) {
+    if (g->journal_enabled && !reserve_words(g->heap, &g->journal, &g->journal_capacity,
+                                             g->journal_length, JOURNAL_MAX_RECORD)) {
+            COUNT(g, rejected_memory);
+
+            return false;
+    }
+
+    // Most moves of a player without free areas are rejected, they do not
+    // need the stencil. In the concurrent mode the counters and the frontier
+    // of the player are read under its lock in place_figure.
+    if (!g->concurrency && player_occupied_all_areas(g, player) &&
+        !touches_player(g, player, x, y)) {
+        COUNT(g, rejected_areas);
+
+        return false;
+    }
+
+    stencil_t stencil;
+    neighbourhood_t around;
+
+    gather_stencil(g, tile, x, y, &stencil);
+    read_neighbourhood(&stencil, &around);
+
+    // The move changes the player and the players of its neighbours.
+    uint64_t players = 1ULL << (player - 1);
+
+    for (uint64_t i = 0; i < around.players_length; i++) {
+        players |= 1ULL << (around.players[i] - 1);
+    }
+
+    lock_players(g, players);
+
+    bool done = place_figure(g, tile, &stencil, &around, player, x, y);
+
+    unlock_players(g, players);
+
+    return done;
+}
+
+// Makes the move of the valid player on the valid field (x,y), see game_move.
+static bool make_move(game_t* g, uint32_t player, uint32_t x, uint32_t y) {
+    tile_t* tile;
+
+    if (!empty_coordinate(g, x, y)) {
+        COUNT(g, rejected_busy);
+
+        return false;
+    }
+    if (!(tile = writable_tile(g, x, y))) {
+        COUNT(g, rejected_memory);
+
+        return false;
+    }
+
+    return put_figure(g, tile, player, x, y);
+}
+
+bool game_move(game_t* g, uint32_t player, uint32_t x, uint32_t y) {
+    if (!g) {
+        return false;
+    }
+    if (!correct_player_number(g, player) || !correct_coordinate(g, x, y)) {
+        COUNT(g, rejected_invalid);
+
+        return false;
+    }
+    if (!make_move(g, player, x, y)) {
+        return false;
+    }
+
+    // A new move makes the undone moves impossible to redo.
+    g->redo_length = 0;
+
+    return true;
+}
+
+size_t game_move_batch(game_t* g, move_t const* moves, size_t n, uint8_t* results) {
+    if (!g) {
+        if (results) {
+            memset(results, 0, n);
+        }
+
+        return 0;
+    }
+
+    size_t accepted = 0;
+
+    // No clone can be made during this call, so a tile which was made
+    // writable stays writable and the next moves in it may skip
+    // the lookup of the tile and the checks of its references.
+    tile_t* last_tile = NULL;
+    uint64_t last_number = UINT64_MAX;
+
+    for (size_t i = 0; i < n; i++) {
+        uint32_t player = moves[i].player;
+        uint32_t x = moves[i].x;
+        uint32_t y = moves[i].y;
+        bool done = false;
+
+        if (!correct_player_number(g, player) || !correct_coordinate(g, x, y)) {
+            COUNT(g, rejected_invalid);
+        }
+        else {
+            uint64_t number = tile_number(g, x, y);
+
+            if (number != last_number || tile_full(last_tile)) {
+                last_tile = empty_coordinate(g, x, y) ? writable_tile(g, x, y) : NULL;
+                last_number = last_tile ? number : UINT64_MAX;
+            }
+
+            if (!last_tile) {
+                if (empty_coordinate(g, x, y)) {
+                    COUNT(g, rejected_memory);
+                }
+                else {
+                    COUNT(g, rejected_busy);
+                }
+            }
+            else if (tile_player(last_tile, tile_index(x, y)) != 0) {
+                COUNT(g, rejected_busy);
+            }
+            else {
+                done = put_figure(g, last_tile, player, x, y);
+            }
+        }
+
+        if (results) {
+            results[i] = done;
+        }
+
+        accepted += done;
+    }
+
+    // A new move makes the undone moves impossible to redo.
+    if (accepted > 0) {
+        g->redo_length = 0;
+    }
+
+    return accepted;
+}
+
+// Allocates the state of the concurrent mode and everything its moves
+// would share: all directories and the occupancy bitplane. Returns false
+// and sets errno if it failed.
+static bool start_concurrency(game_t* g) {
+    if (g->number_of_directories > MAX_CONCURRENT_DIRECTORIES) {
+        errno = ENOMEM;
+        return false;
+    }
+
+    for (uint64_t i = 0; i < g->number_of_directories; i++) {
+        if (!writable_directory(g, i)) {
+            return false;
+        }
+    }
+
+    if (g->planes && !writable_plane(g, 0)) {
+        return false;
+    }
+
+    uint64_t tiles = (((uint64_t)g->width + TILE_SIDE - 1) / TILE_SIDE) * g->tiles_height;
+    uint64_t regions = 1;
+
+    while (regions < tiles && regions < MAX_REGIONS) {
+        regions *= 2;
+    }
+
+    concurrency_t* concurrency = heap_allocate(g->heap, sizeof(concurrency_t) +
+                                                        regions * sizeof(pthread_mutex_t), true);
+
+    if (!concurrency) {
+        return false;
+    }
+
+    for (uint32_t i = 0; i < MAX_PLAYERS; i++) {
+        pthread_mutex_init(&concurrency->players[i].lock, NULL);
+    }
+    for (uint64_t i = 0; i < regions; i++) {
+        pthread_mutex_init(&concurrency->regions[i], NULL);
+    }
+
+    pthread_mutex_init(&concurrency->forest, NULL);
+    concurrency->regions_length = regions;
+    g->concurrency = concurrency;
+    g->redo_length = 0;
+
+    return true;
+}
+
+// Ends the concurrent mode, computes the values of the game which were not
+// updated by its moves.
+static void end_concurrency(game_t* g) {
+    uint64_t busy_fields = 0;
+
+    for (uint32_t i = 0; i < g->number_of_players; i++) {
+        busy_fields += g->all_players[i].busy_fields;
+        g->hash ^= g->concurrency->players[i].hash;
+    }
+
+    release_concurrency(g);
+    g->fields_to_take = (uint64_t)g->width * (uint64_t)g->height - busy_fields;
+
+    for (uint32_t i = 1; i <= g->number_of_players; i++) {
+        update_player_masks(g, i);
+    }
+
+    g->allocated_tiles = 0;
+    g->dense_tiles = 0;
+
+    for (uint64_t i = 0; i < g->number_of_directories; i++) {
+        for (uint32_t j = 0; g->directories[i] && j < DIRECTORY_TILES; j++) {
+            tile_t const* tile = g->directories[i]->tiles[j];
+
+            g->allocated_tiles += tile != NULL;
+            g->dense_tiles += tile && tile->length == TILE_DENSE;
+        }
+    }
+}
+
+bool game_set_concurrent(game_t* g, bool enabled) {
+    if (!g) {
+        return false;
+    }
+    if (!enabled || g->concurrency) {
+        if (!enabled && g->concurrency) {
+            end_concurrency(g);
+        }
+
+        return true;
+    }
+    if (g->journal_enabled) {
+        errno = EINVAL;
+        return false;
+    }
+
+    return start_concurrency(g);
+}
+
+// Writes the numbers of the regions of the tiles of the stencil of the field
+// (x,y) in the increasing order without repetitions, returns their number.
+// The stencil lies in the square of STENCIL_SIDE x STENCIL_SIDE fields, so
+// it takes at most two tiles in each direction.
+static uint32_t stencil_regions(game_t const* g, uint32_t x, uint32_t y, uint64_t* regions) {
+    uint64_t mask = g->concurrency->regions_length - 1;
+    uint32_t columns[2] = {x < STENCIL_RADIUS ? 0 : x - STENCIL_RADIUS,
+                           g->width - 1 - x < STENCIL_RADIUS ? g->width - 1 : x + STENCIL_RADIUS};
+    uint32_t rows[2] = {y < STENCIL_RADIUS ? 0 : y - STENCIL_RADIUS,
+                        g->height - 1 - y < STENCIL_RADIUS ? g->height - 1 : y + STENCIL_RADIUS};
+    uint32_t length = 0;
+
+    for (int i = 0; i < STENCIL_REGIONS; i++) {
+        uint64_t region = tile_number(g, columns[i / 2], rows[i % 2]) & mask;
+        uint32_t position = length;
+        bool copy = false;
+
+        for (uint32_t z = 0; z < length && !copy; z++) {
+            copy = regions[z] == region;
+        }
+
+        if (copy) {
+            continue;
+        }
+
+        while (position > 0 && regions[position - 1] > region) {
+            regions[position] = regions[position - 1];
+            position--;
+        }
+
+        regions[position] = region;
+        length++;
+    }
+
+    return length;
+}
+
+bool game_move_concurrent(game_t* g, uint32_t player, uint32_t x, uint32_t y) {
+    if (!g || !g->concurrency) {
+        return false;
+    }
+    if (!correct_player_number(g, player) || !correct_coordinate(g, x, y)) {
+        COUNT(g, rejected_invalid);
+
+        return false;
+    }
+
+    uint64_t regions[STENCIL_REGIONS];
+    uint32_t length = stencil_regions(g, x, y, regions);
+
+    for (uint32_t i = 0; i < length; i++) {
+        pthread_mutex_lock(&g->concurrency->regions[regions[i]]);
+    }
+
+    bool done = make_move(g, player, x, y);
+
+    for (uint32_t i = length; i > 0; i--) {
+        pthread_mutex_unlock(&g->concurrency->regions[regions[i - 1]]);
+    }
+
+    return done;
+}
+
+bool game_move_preview(game_t const* g, uint32_t player, uint32_t x, uint32_t y,
+                       move_effect_t* effect) {
+    move_effect_t answer = {0};
+
+    if (!g || !correct_player_number(g, player) || !correct_coordinate(g, x, y) ||
+        !empty_coordinate(g, x, y)) {
+        if (effect) {
+            *effect = answer;
+        }
+
+        return false;
+    }
+
+    stencil_t stencil;
+    uint32_t players[MAX_NEIGHBOURS];
+    uint64_t areas[MAX_NEIGHBOURS];
+    uint64_t joined = 0;
+    uint64_t potential = 0;
+    uint64_t busy = 0;
+    uint64_t lookups = 0;
+
+    gather_stencil(g, find_tile(g, x, y), x, y, &stencil);
+
+    // Count the different areas of the player joined by the move.
+    for (int i = 0; i < MAX_NEIGHBOURS; i++) {
+        uint32_t neighbour = stencil_player(&stencil, neighbour_dx[i], neighbour_dy[i]);
+
+        potential += neighbour != STENCIL_OUTSIDE;
+        busy += neighbour != STENCIL_OUTSIDE && neighbour != 0;
+
+        if (neighbour == player) {
+            uint64_t root = area_root(g, stencil.colors[STENCIL_RADIUS + neighbour_dx[i]]
+                                                       [STENCIL_RADIUS + neighbour_dy[i]]);
+            bool copy = false;
+
+            for (uint64_t z = 0; z < joined && !copy; z++) {
+                copy = areas[z] == root;
+            }
+
+            if (!copy) {
+                areas[joined++] = root;
+            }
+        }
+    }
+
+    if (joined == 0 && player_occupied_all_areas(g, player)) {
+        if (effect) {
+            *effect = answer;
+        }
+
+        return false;
+    }
+
+    // The same changes of the players as made by put_figure.
+    uint64_t length = neighbour_players(&stencil, players);
+
+    answer.legal = true;
+    answer.areas = 1 - (int32_t)joined;
+    answer.boundary = (int64_t)(potential - busy -
+                                check_non_direct_neighbours(&stencil, player, &lookups));
+
+    for (uint64_t i = 0; i < length; i++) {
+        if (players[i] == player) {
+            answer.boundary--;
+        }
+        else {
+            answer.opponents[answer.opponents_length++] = players[i];
+        }
+    }
+
+    if (effect) {
+        *effect = answer;
+    }
+
+    return true;
+}
+
+game_t* game_clone(game_t const* g) {
+    if (!g) {
+        return NULL;
+    }
+
+    heap_t* heap = g->heap;
+    game_t* clone = heap_allocate(heap, sizeof(game_t), false);
+
+    if (!clone) {
+        return NULL;
+    }
+
+    *clone = *g;
+    clone->concurrency = NULL;
+#ifdef GAME_STATS
+    memset(&clone->stats, 0, sizeof(game_stats_t));
+#endif
+    clone->journal = NULL;
+    clone->journal_length = 0;
+    clone->journal_capacity = 0;
+    clone->redo = NULL;
+    clone->redo_length = 0;
+    clone->redo_capacity = 0;
+    clone->all_players = heap_allocate(heap, g->number_of_players * sizeof(player_t), false);
+    clone->frontiers = heap_allocate(heap, g->number_of_players * sizeof(frontier_t*), false);
+    clone->planes = !g->planes ? NULL :
+                    heap_allocate(heap, (g->number_of_players + 1) * sizeof(bitplane_t*), false);
+    clone->directories = heap_allocate(heap, g->number_of_directories * sizeof(directory_t*),
+                                       false);
+    clone->area_blocks = g->number_of_area_blocks == 0 ? NULL :
+                         heap_allocate(heap, g->number_of_area_blocks * sizeof(area_block_t*),
+                                       false);
+
+    if (!clone->all_players || !clone->frontiers || !clone->directories ||
+        (!clone->planes && g->planes) ||
+        (!clone->area_blocks && g->number_of_area_blocks > 0)) {
+        heap_free(heap, clone->all_players, g->number_of_players * sizeof(player_t));
+        heap_free(heap, clone->frontiers, g->number_of_players * sizeof(frontier_t*));
+        heap_free(heap, clone->planes, (g->number_of_players + 1) * sizeof(bitplane_t*));
+        heap_free(heap, clone->directories, g->number_of_directories * sizeof(directory_t*));
+        heap_free(heap, clone->area_blocks, g->number_of_area_blocks * sizeof(area_block_t*));
+        heap_free(heap, clone, sizeof(game_t));
+
+        return NULL;
+    }
+
+    memcpy(clone->all_players, g->all_players, g->number_of_players * sizeof(player_t));
+    memcpy(clone->frontiers, g->frontiers, g->number_of_players * sizeof(frontier_t*));
+    memcpy(clone->directories, g->directories,
+           g->number_of_directories * sizeof(directory_t*));
+
+    if (g->number_of_area_blocks > 0) {
+        memcpy(clone->area_blocks, g->area_blocks,
+               g->number_of_area_blocks * sizeof(area_block_t*));
+    }
+
+    if (g->planes) {
+        memcpy(clone->planes, g->planes, (g->number_of_players + 1) * sizeof(bitplane_t*));
+    }
+
+    share(&heap->references);
+
+    if (g->mapping) {
+        share(&g->mapping->references);
+    }
+
+    // Share all directories, area blocks, frontiers and bitplanes with the clone.
+    for (uint64_t i = 0; i < g->number_of_directories; i++) {
+        if (g->directories[i]) {
+            share(&g->directories[i]->references);
+        }
+    }
+    for (uint64_t i = 0; i < g->number_of_area_blocks; i++) {
+        if (g->area_blocks[i]) {
+            share(&g->area_blocks[i]->references);
+        }
+    }
+    for (uint32_t i = 0; i < g->number_of_players; i++) {
+        if (g->frontiers[i]) {
+            share(&g->frontiers[i]->references);
+        }
+    }
+    for (uint32_t i = 0; g->planes && i <= g->number_of_players; i++) {
+        if (g->planes[i]) {
+            share(&g->planes[i]->references);
+        }
+    }
+
+    return clone;
+}
+
+void game_set_journal(game_t* g, bool enabled) {
+    if (!g) {
+        return;
+    }
+
+    g->journal_enabled = enabled;
+    g->journal_length = 0;
+    g->redo_length = 0;
+}
+
+bool game_undo(game_t* g) {
+    if (!g || g->journal_length == 0 ||
+        !reserve_words(g->heap, &g->redo, &g->redo_capacity, g->redo_length, 2)) {
+        return false;
+    }
+
+    uint64_t description = g->journal[g->journal_length - 1];
+    uint64_t index = g->journal[g->journal_length - 2];
+    uint32_t player = (uint32_t)(description & JOURNAL_PLAYER_MASK);
+    uint32_t unions = (uint32_t)((description >> JOURNAL_UNIONS) & JOURNAL_FIELD_BITS);
+    uint64_t neighbours = (description >> JOURNAL_NEIGHBOURS) & JOURNAL_FIELD_BITS;
+    uint32_t x = (uint32_t)(index / g->height);
+    uint32_t y = (uint32_t)(index % g->height);
+    player_t* me = &g->all_players[player - 1];
+    tile_t* tile = writable_tile(g, x, y);
+
+    if (!tile) {
+        return false;
+    }
+
+    // The split areas are modified, so they can not be shared.
+    for (uint32_t i = 0; i < 2 * unions; i++) {
+        if (!writable_area_block(g, g->journal[g->journal_length - 3 - i])) {
+            return false;
+        }
+    }
+
+    // The field goes back to the frontiers of its neighbours.
+    if (g->planes) {
+        if (!writable_plane(g, 0) || !writable_plane(g, player)) {
+            return false;
+        }
+    }
+    else {
+        if (!writable_frontier(g, player, 0)) {
+            return false;
+        }
+
+        for (uint64_t i = 0; i < neighbours; i++) {
+            uint64_t neighbour = (description >> (JOURNAL_NEIGHBOUR + 8 * i)) &
+                                 JOURNAL_PLAYER_MASK;
+
+            if (!writable_frontier(g, (uint32_t)neighbour, 1)) {
+                return false;
+            }
+        }
+    }
+
+    g->journal_length -= 2;
+
+    // Restore the players.
+    me->busy_fields--;
+    me->boundary_length -= (description >> JOURNAL_BOUNDARY) & JOURNAL_FIELD_BITS;
+
+    if (description & JOURNAL_NEW_AREA) {
+        me->busy_areas--;
+        g->next_color--;
+    }
+    else {
+        me->busy_areas += unions;
+    }
+
+    for (uint64_t i = 0; i < neighbours; i++) {
+        uint64_t neighbour = (description >> (JOURNAL_NEIGHBOUR + 8 * i)) & JOURNAL_PLAYER_MASK;
+        g->all_players[neighbour - 1].boundary_length++;
+        update_player_masks(g, (uint32_t)neighbour);
+    }
+
+    update_player_masks(g, player);
+
+    // Split the joined areas in the reverse order.
+    for (uint32_t i = 0; i < unions; i++) {
+        uint64_t first = g->journal[--g->journal_length];
+        uint64_t second = g->journal[--g->journal_length];
+
+        area_block(g, second)->parent[second & AREA_BLOCK_MASK] = second;
+        area_block(g, first)->size[first & AREA_BLOCK_MASK] -=
+            area_block(g, second)->size[second & AREA_BLOCK_MASK];
+    }
+
+    set_tile_field(tile, tile_index(x, y), 0, 0);
+    g->fields_to_take++;
+    g->hash ^= zobrist_key(field_index(g, x, y), player);
+
+    // Restore the frontiers.
+    if (g->planes) {
+        g->planes[0]->words[plane_word(g, x, y)] &= ~(1ULL << (y & 63));
+        g->planes[player]->words[plane_word(g, x, y)] &= ~(1ULL << (y & 63));
+    }
+    else {
+        remove_from_frontier(g, player, x - 1, y);
+        remove_from_frontier(g, player, x + 1, y);
+        remove_from_frontier(g, player, x, y - 1);
+        remove_from_frontier(g, player, x, y + 1);
+
+        for (uint64_t i = 0; i < neighbours; i++) {
+            uint64_t neighbour = (description >> (JOURNAL_NEIGHBOUR + 8 * i)) &
+                                 JOURNAL_PLAYER_MASK;
+            frontier_insert(g->frontiers[neighbour - 1], index);
+        }
+    }
+
+    g->redo[g->redo_length++] = index;
+    g->redo[g->redo_length++] = player;
+
+    return true;
+}
+
+bool game_redo(game_t* g) {
+    if (!g || g->redo_length == 0) {
+        return false;
+    }
+
+    uint32_t player = (uint32_t)g->redo[g->redo_length - 1];
+    uint64_t index = g->redo[g->redo_length - 2];
+
+    if (!make_move(g, player, (uint32_t)(index / g->height), (uint32_t)(index % g->height))) {
+        return false;
+    }
+
+    g->redo_length -= 2;
+
+    return true;
+}
+
+// Frees all fields of the board. Exclusive tiles are cleared and kept
+// for the next game, shared tiles and directories are released.
+static void reset_tiles(game_t* g) {
+    for (uint64_t i = 0; i < g->number_of_directories; i++) {
+        directory_t* directory = g->directories[i];
+
+        if (!directory) {
+            continue;
+        }
+
+        bool shared = !exclusive(&directory->references);
+
+        for (uint32_t j = 0; j < DIRECTORY_TILES; j++) {
+            tile_t* tile = directory->tiles[j];
+
+            if (!tile) {
+                continue;
+            }
+            if (shared || !exclusive(&tile->references)) {
+                g->allocated_tiles--;
+                g->dense_tiles -= tile->length == TILE_DENSE;
+
+                if (!shared) {
+                    release_tile(g, tile);
+                    directory->tiles[j] = NULL;
+                }
+            }
+            else if (tile->length == TILE_DENSE) {
+                memset(tile_players(tile), 0, TILE_FIELDS);
+            }
+            else {
+                tile->length = 0;
+            }
+        }
+
+        if (shared) {
+            release_directory(g, directory);
+            g->directories[i] = NULL;
+            g->allocated_directories--;
+        }
+    }
+}
+
+// Empties the frontiers and the bitplanes of all players, the exclusive
+// ones are cleared and kept. Returns false if the new occupancy bitplane
+// could not be allocated.
+static bool reset_frontiers(game_t* g) {
+    for (uint32_t i = 0; i < g->number_of_players; i++) {
+        frontier_t* frontier = g->frontiers[i];
+
+        if (frontier && exclusive(&frontier->references)) {
+            for (uint64_t j = 0; j < frontier->capacity; j++) {
+                frontier->fields[j] = FRONTIER_EMPTY;
+            }
+
+            frontier->length = 0;
+        }
+        else if (frontier) {
+            release_frontier(g, frontier);
+            g->frontiers[i] = NULL;
+        }
+    }
+
+    for (uint32_t i = 0; g->planes && i <= g->number_of_players; i++) {
+        bitplane_t* plane = g->planes[i];
+
+        if (plane && exclusive(&plane->references)) {
+            memset(plane->words, 0, g->plane_words * sizeof(uint64_t));
+        }
+        else if (plane) {
+            release_plane(g, plane);
+            g->planes[i] = NULL;
+        }
+    }
+
+    if (g->planes && !writable_plane(g, 0)) {
+        return false;
+    }
+    if (g->planes) {
+        mark_rows_after_board(g, g->planes[0]);
+    }
+
+    return true;
+}
+
+bool game_reset(game_t* g) {
+    if (!g) {
+        return false;
+    }
+
+    reset_tiles(g);
+
+    // The area blocks are kept, the colors are assigned from the beginning
+    // and every new area overwrites its entry.
+    for (uint32_t i = 0; i < g->number_of_players; i++) {
+        g->all_players[i].busy_fields = 0;
+        g->all_players[i].busy_areas = 0;
+        g->all_players[i].boundary_length = 0;
+    }
+
+    g->fields_to_take = (uint64_t)g->width * (uint64_t)g->height;
+    g->full_players = 0;
+    g->bordered_players = 0;
+    g->hash = 0;
+    g->next_color = 1;
+    g->journal_length = 0;
+    g->redo_length = 0;
+#ifdef GAME_STATS
+    memset(&g->stats, 0, sizeof(game_stats_t));
+#endif
+
+    return reset_frontiers(g);
+}
+
+/** @brief A pool of games reset for the next use:
+ * games           - the games returned to the pool,
+ * length          - the number of the games in the pool,
+ * capacity        - the maximum number of the games kept by the pool.
+ */
+struct game_pool {
+    game_t** games;
+    size_t length;
+    size_t capacity;
+};
+
+game_pool_t* game_pool_new(size_t capacity) {
+    game_pool_t* pool = calloc(1, sizeof(game_pool_t));
+
+    if (!pool) {
+        return NULL;
+    }
+
+    pool->games = capacity == 0 ? NULL : malloc(capacity * sizeof(game_t*));
+
+    if (!pool->games && capacity > 0) {
+        free(pool);
+
+        return NULL;
+    }
+
+    pool->capacity = capacity;
+
+    return pool;
+}
+
+void game_pool_delete(game_pool_t* pool) {
+    if (!pool) {
+        return;
+    }
+
+    for (size_t i = 0; i < pool->length; i++) {
+        game_delete(pool->games[i]);
+    }
+
+    free(pool->games);
+    free(pool);
+}
+
+game_t* game_pool_get(game_pool_t* pool, uint32_t width, uint32_t height,
+                      uint32_t players, uint32_t areas) {
+    // The most recently returned game is taken first, its memory is
+    // the most likely to be in the cache.
+    for (size_t i = pool ? pool->length : 0; i-- > 0;) {
+        game_t* g = pool->games[i];
+
+        if (g->width == width && g->height == height &&
+            g->number_of_players == players && g->max_areas == areas) {
+            memmove(pool->games + i, pool->games + i + 1,
+                    (pool->length - i - 1) * sizeof(game_t*));
+            pool->length--;
+
+            return g;
+        }
+    }
+
+    return game_new(width, height, players, areas);
+}
+
+void game_pool_put(game_pool_t* pool, game_t* g) {
+    if (!g) {
+        return;
+    }
+
+    // A full pool drops its oldest game.
+    if (pool && pool->capacity > 0 && game_reset(g)) {
+        if (pool->length == pool->capacity) {
+            game_delete(pool->games[0]);
+            memmove(pool->games, pool->games + 1, (pool->length - 1) * sizeof(game_t*));
+            pool->length--;
+        }
+
+        pool->games[pool->length++] = g;
+
+        return;
+    }
+
+    game_delete(g);
+}
+
+// The first bytes of a saved game and the version of its layout.
+#define SNAPSHOT_MAGIC "IPPGAME"
+#define SNAPSHOT_VERSION 3
+
+// Describes the constants and the structures the layout depends on, a file
+// saved by the engine built with other ones is rejected.
+#define SNAPSHOT_LAYOUT ((uint64_t)TILE_SHIFT | (uint64_t)AREA_BLOCK_SHIFT << 8 | \
+                         (uint64_t)TILE_SPARSE_FIELDS << 16 | \
+                         (uint64_t)sizeof(player_t) << 32 | (uint64_t)sizeof(tile_t) << 48)
+
+// Marks a dense tile in the table of tiles of a saved game.
+#define SNAPSHOT_DENSE (1ULL << 63)
+
+/** @brief The beginning of a file written by game_save. All offsets are
+ * counted from the beginning of the file and are multiples of 8:
+ * magic, version, layout - see SNAPSHOT_*,
+ * width ... hash         - the fields of the game (plane_words is zero for
+ *                          a game without bitplanes),
+ * number_of_tiles        - the number of allocated tiles,
+ * players_offset         - the offset of the array of all players,
+ * tables_offset          - the offset of the tables of pieces: the offsets of
+ *                          number_of_area_blocks area blocks, then
+ *                          number_of_tiles pairs (the number of the tile,
+ *                          with SNAPSHOT_DENSE for a dense one, and its offset),
+ *                          then the offsets of the frontiers of all players
+ *                          and of all bitplanes if the game has them; zero
+ *                          stands for NULL,
+ * size                   - the length of the file.
+ * The pieces follow the tables, each one is written as it is kept in memory,
+ * but with MAPPED_REFERENCES references.
+ */
+typedef struct Snapshot {
+    char magic[8];
+    uint64_t version;
+    uint64_t layout;
+    uint64_t width;
+    uint64_t height;
+    uint64_t players;
+    uint64_t areas;
+    uint64_t fields_to_take;
+    uint64_t next_color;
+    uint64_t number_of_area_blocks;
+    uint64_t plane_words;
+    uint64_t hash;
+    uint64_t number_of_tiles;
+    uint64_t players_offset;
+    uint64_t tables_offset;
+    uint64_t size;
+} snapshot_t;
+
+// Rounds the number of bytes up to a multiple of 8.
+static uint64_t aligned(uint64_t const size) {
+    return (size + 7) & ~7ULL;
+}
+
+// Returns the number of words of the tables of pieces of the saved game.
+static uint64_t snapshot_table_words(game_t const* g) {
+    return g->number_of_area_blocks + 2 * g->allocated_tiles + g->number_of_players +
+           (g->planes ? g->number_of_players + 1 : 0);
+}
+
+// Writes the piece of the given size, which starts with its counter of
+// references, and pads it to a multiple of 8 bytes.
+static bool write_piece(FILE* file, void const* piece, uint64_t const size) {
+    static char const padding[8];
+    atomic_uint_fast32_t references;
+
+    atomic_init(&references, MAPPED_REFERENCES);
+
+    return fwrite(&references, sizeof(references), 1, file) == 1 &&
+           fwrite((char const*)piece + sizeof(references), size - sizeof(references),
+                  1, file) == 1 &&
+           (aligned(size) == size || fwrite(padding, aligned(size) - size, 1, file) == 1);
+}
+
+// Fills the header and the tables of pieces of the saved game.
+static void snapshot_layout(game_t const* g, snapshot_t* snapshot, uint64_t* table) {
+    uint64_t position;
+    uint64_t entry = 0;
+
+    memset(snapshot, 0, sizeof(snapshot_t));
+    memcpy(snapshot->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC));
+    snapshot->version = SNAPSHOT_VERSION;
+    snapshot->layout = SNAPSHOT_LAYOUT;
+    snapshot->width = g->width;
+    snapshot->height = g->height;
+    snapshot->players = g->number_of_players;
+    snapshot->areas = g->max_areas;
+    snapshot->fields_to_take = g->fields_to_take;
+    snapshot->next_color = g->next_color;
+    snapshot->hash = g->hash;
+    snapshot->number_of_area_blocks = g->number_of_area_blocks;
+    snapshot->plane_words = g->planes ? g->plane_words : 0;
+    snapshot->number_of_tiles = g->allocated_tiles;
+    snapshot->players_offset = sizeof(snapshot_t);
+    snapshot->tables_offset = snapshot->players_offset +
+                              aligned(g->number_of_players * sizeof(player_t));
+    position = snapshot->tables_offset + snapshot_table_words(g) * sizeof(uint64_t);
+
+    for (uint64_t i = 0; i < g->number_of_area_blocks; i++, entry++) {
+        table[entry] = g->area_blocks[i] ? position : 0;
+        position += g->area_blocks[i] ? aligned(sizeof(area_block_t)) : 0;
+    }
+    for (uint64_t i = 0; i < g->number_of_directories; i++) {
+        for (uint32_t j = 0; g->directories[i] && j < DIRECTORY_TILES; j++) {
+            tile_t const* tile = g->directories[i]->tiles[j];
+
+            if (tile) {
+                table[entry++] = ((i << DIRECTORY_SHIFT) | j) |
+                                 (tile->length == TILE_DENSE ? SNAPSHOT_DENSE : 0);
+                table[entry++] = position;
+                position += aligned(tile_size(tile));
+            }
+        }
+    }
+    for (uint32_t i = 0; i < g->number_of_players; i++, entry++) {
+        table[entry] = g->frontiers[i] ? position : 0;
+        position += g->frontiers[i] ? aligned(frontier_size(g->frontiers[i])) : 0;
+    }
+    for (uint32_t i = 0; g->planes && i <= g->number_of_players; i++, entry++) {
+        table[entry] = g->planes[i] ? position : 0;
+        position += g->planes[i] ? aligned(sizeof(bitplane_t) +
+                                           g->plane_words * sizeof(uint64_t)) : 0;
+    }
+
+    snapshot->size = position;
+}
+
+// Writes the saved game laid out by snapshot_layout, the pieces are
+// written in the order of the tables.
+static bool write_snapshot(game_t const* g, FILE* file, snapshot_t const* snapshot,
+                           uint64_t const* table) {
+    static char const padding[8];
+    uint64_t players_size = g->number_of_players * sizeof(player_t);
+    uint64_t entry = 0;
+
+    if (fwrite(snapshot, sizeof(snapshot_t), 1, file) != 1 ||
+        fwrite(g->all_players, players_size, 1, file) != 1 ||
+        (aligned(players_size) != players_size &&
+         fwrite(padding, aligned(players_size) - players_size, 1, file) != 1) ||
+        fwrite(table, sizeof(uint64_t), snapshot_table_words(g), file) !=
+        snapshot_table_words(g)) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < g->number_of_area_blocks; i++, entry++) {
+        if (table[entry] && !write_piece(file, g->area_blocks[i], sizeof(area_block_t))) {
+            return false;
+        }
+    }
+    for (uint64_t i = 0; i < g->allocated_tiles; i++, entry += 2) {
+        uint64_t number = table[entry] & ~SNAPSHOT_DENSE;
+        tile_t const* tile = g->directories[number >> DIRECTORY_SHIFT]->tiles[number &
+                                                                             DIRECTORY_MASK];
+
+        if (!write_piece(file, tile, tile_size(tile))) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; i < g->number_of_players; i++, entry++) {
+        if (table[entry] && !write_piece(file, g->frontiers[i], frontier_size(g->frontiers[i]))) {
+            return false;
+        }
+    }
+    for (uint32_t i = 0; g->planes && i <= g->number_of_players; i++, entry++) {
+        if (table[entry] && !write_piece(file, g->planes[i], sizeof(bitplane_t) +
+                                         g->plane_words * sizeof(uint64_t))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+bool game_save(game_t const* g, char const* path) {
+    if (!g || !path) {
+        return false;
+    }
+
+    size_t length = strlen(path);
+    char* temporary = malloc(length + sizeof(".tmp"));
+    uint64_t* table = malloc((snapshot_table_words(g) + 1) * sizeof(uint64_t));
+    snapshot_t snapshot;
+    FILE* file = NULL;
+    bool written = false;
+
+    if (!temporary || !table) {
+        errno = ENOMEM;
+    }
+    else {
+        memcpy(temporary, path, length);
+        memcpy(temporary + length, ".tmp", sizeof(".tmp"));
+        snapshot_layout(g, &snapshot, table);
+        file = fopen(temporary, "wb");
+    }
+
+    // The old file is replaced only by the completely written new one.
+    if (file) {
+        written = write_snapshot(g, file, &snapshot, table) && fflush(file) == 0 &&
+                  fsync(fileno(file)) == 0;
+        written = fclose(file) == 0 && written && rename(temporary, path) == 0;
+
+        if (!written) {
+            int error = errno;
+            remove(temporary);
+            errno = error;
+        }
+    }
+
+    free(temporary);
+    free(table);
+
+    return written;
+}
+
+bool game_sync(game_t const* g) {
+    if (!g) {
+        return false;
+    }
+    if (!g->mapping) {
+        errno = EINVAL;
+        return false;
+    }
+
+    return game_save(g, g->mapping->path);
+}
+
+// Returns true if the piece of the given size at the offset lies in the file.
+static bool correct_piece(uint64_t const offset, uint64_t const size, uint64_t const file_size) {
+    return offset % 8 == 0 && offset <= file_size && size <= file_size - offset;
+}
+
+// Returns the block of the saved game containing the color or NULL if
+// the color has no block. The offsets of the blocks must be already checked.
+static area_block_t const* snapshot_block(char const* base, snapshot_t const* snapshot,
+                                          uint64_t const color) {
+    uint64_t const* blocks = (uint64_t const*)(base + snapshot->tables_offset);
+    uint64_t number = color >> AREA_BLOCK_SHIFT;
+
+    if (number >= snapshot->number_of_area_blocks || blocks[number] == 0) {
+        return NULL;
+    }
+
+    return (area_block_t const*)(base + blocks[number]);
+}
+
+// Returns true if the color of a busy field of the saved game was given
+// to an area, so it has a block and a tree of a positive size.
+static bool correct_color(char const* base, snapshot_t const* snapshot, uint64_t const color) {
+    area_block_t const* block = snapshot_block(base, snapshot, color);
+
+    return color < snapshot->next_color && block && block->size[color & AREA_BLOCK_MASK] > 0;
+}
+
+// Returns true if every used color (with a positive size) of the block
+// with the given number is a representative or its parent has a bigger
+// tree. The sizes grow towards the representatives, so find_area stops.
+static bool correct_area_block(char const* base, snapshot_t const* snapshot,
+                               uint64_t const number) {
+    area_block_t const* block = snapshot_block(base, snapshot, number << AREA_BLOCK_SHIFT);
+
+    for (uint64_t i = 0; i < AREA_BLOCK_COLORS; i++) {
+        uint64_t color = (number << AREA_BLOCK_SHIFT) | i;
+        uint64_t parent = block->parent[i];
+
+        if (block->size[i] == 0 || parent == color) {
+            continue;
+        }
+
+        area_block_t const* parent_block = snapshot_block(base, snapshot, parent);
+
+        if (!parent_block || parent_block->size[parent & AREA_BLOCK_MASK] <= block->size[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns true if the tile with the given number of the saved game has
+// the length of its kind, different fields inside the board, player numbers
+// of the game and used colors.
+static bool correct_tile(char const* base, snapshot_t const* snapshot, tile_t const* tile,
+                         uint64_t const number, bool const dense) {
+    if (dense != (tile->length == TILE_DENSE) ||
+        (!dense && tile->length > TILE_SPARSE_FIELDS)) {
+        return false;
+    }
+
+    uint64_t tiles_height = (snapshot->height + TILE_SIDE - 1) / TILE_SIDE;
+    uint64_t left = number / tiles_height * TILE_SIDE;
+    uint64_t top = number % tiles_height * TILE_SIDE;
+    uint8_t const* players = tile_players(tile);
+    uint64_t seen[TILE_FIELDS / 64] = {0};
+    uint32_t length = dense ? TILE_FIELDS : tile->length;
+
+    for (uint32_t i = 0; i < length; i++) {
+        uint32_t index = dense ? i : sparse_indices(tile)[i];
+
+        if (index >= TILE_FIELDS || (seen[index / 64] >> (index % 64) & 1) ||
+            (!dense && players[i] == 0)) {
+            return false;
+        }
+
+        seen[index / 64] |= 1ULL << (index % 64);
+
+        if (players[i] != 0 &&
+            (players[i] > snapshot->players ||
+             left + (index >> TILE_SHIFT) >= snapshot->width ||
+             top + (index & TILE_MASK) >= snapshot->height ||
+             !correct_color(base, snapshot, tile->colors[i]))) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Returns true if the frontier at the offset lies in the file, its capacity
+// is a power of two and it keeps length fields of the board, so at least
+// one slot is free.
+static bool correct_frontier(char const* base, snapshot_t const* snapshot,
+                             uint64_t const offset) {
+    if (!correct_piece(offset, sizeof(frontier_t), snapshot->size)) {
+        return false;
+    }
+
+    frontier_t const* frontier = (frontier_t const*)(base + offset);
+    uint64_t capacity = frontier->capacity;
+    uint64_t length = 0;
+
+    if (capacity == 0 || (capacity & (capacity - 1)) != 0 || frontier->length >= capacity ||
+        capacity > (snapshot->size - offset - sizeof(frontier_t)) / sizeof(uint64_t)) {
+        return false;
+    }
+
+    for (uint64_t i = 0; i < capacity; i++) {
+        if (frontier->fields[i] != FRONTIER_EMPTY) {
+            if (frontier->fields[i] >= snapshot->width * snapshot->height) {
+                return false;
+            }
+
+            length++;
+        }
+    }
+
+    return length == frontier->length;
+}
+
+// Returns true if the file of the given size describes a game saved by
+// this version of the engine and all its pieces are correct, so the engine
+// may use them in place.
+static bool correct_snapshot(char const* base, uint64_t const size) {
+    snapshot_t const* snapshot = (snapshot_t const*)base;
+
+    if (!(memcmp(snapshot->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) == 0 &&
+          snapshot->version == SNAPSHOT_VERSION && snapshot->layout == SNAPSHOT_LAYOUT &&
+          snapshot->size == size && snapshot->width > 0 && snapshot->width <= UINT32_MAX &&
+          snapshot->height > 0 && snapshot->height <= UINT32_MAX &&
+          snapshot->players > 0 && snapshot->players <= MAX_PLAYERS &&
+          snapshot->areas > 0 && snapshot->areas <= UINT32_MAX &&
+          snapshot->fields_to_take <= snapshot->width * snapshot->height &&
+          snapshot->number_of_area_blocks <= size / sizeof(uint64_t) &&
+          snapshot->number_of_tiles <= size / SPARSE_TILE_SIZE &&
+          snapshot->plane_words <= size / sizeof(uint64_t) &&
+          correct_piece(snapshot->players_offset, snapshot->players * sizeof(player_t), size) &&
+          correct_piece(snapshot->tables_offset, (snapshot->number_of_area_blocks +
+                        2 * snapshot->number_of_tiles + snapshot->players +
+                        (snapshot->plane_words ? snapshot->players + 1 : 0)) *
+                        sizeof(uint64_t), size))) {
+        return false;
+    }
+
+    player_t const* players = (player_t const*)(base + snapshot->players_offset);
+    uint64_t const* table = (uint64_t const*)(base + snapshot->tables_offset);
+    uint64_t fields = snapshot->width * snapshot->height;
+    uint64_t tiles = ((snapshot->width + TILE_SIDE - 1) / TILE_SIDE) *
+                     ((snapshot->height + TILE_SIDE - 1) / TILE_SIDE);
+
+    for (uint64_t i = 0; i < snapshot->players; i++) {
+        if (players[i].busy_fields > fields || players[i].boundary_length > fields ||
+            players[i].busy_areas > snapshot->areas) {
+            return false;
+        }
+    }
+
+    // The colors of tiles and parents are checked after all blocks are found.
+    for (uint64_t i = 0; i < snapshot->number_of_area_blocks; i++) {
+        if (table[i] != 0 && !correct_piece(table[i], sizeof(area_block_t), size)) {
+            return false;
+        }
+    }
+    for (uint64_t i = 0; i < snapshot->number_of_area_blocks; i++, table++) {
+        if (*table != 0 && !correct_area_block(base, snapshot, i)) {
+            return false;
+        }
+    }
+
+    for (uint64_t i = 0; i < snapshot->number_of_tiles; i++, table += 2) {
+        uint64_t number = table[0] & ~SNAPSHOT_DENSE;
+        bool dense = table[0] & SNAPSHOT_DENSE;
+
+        if (number >= tiles ||
+            !correct_piece(table[1], dense ? DENSE_TILE_SIZE : SPARSE_TILE_SIZE, size) ||
+            !correct_tile(base, snapshot, (tile_t const*)(base + table[1]), number, dense)) {
+            return false;
+        }
+    }
+
+    for (uint64_t i = 0; i < snapshot->players; i++, table++) {
+        if (*table != 0 && !correct_frontier(base, snapshot, *table)) {
+            return false;
+        }
+    }
+
+    for (uint64_t i = 0; snapshot->plane_words && i <= snapshot->players; i++, table++) {
+        if ((*table == 0 && i == 0) ||
+            !correct_piece(*table, sizeof(bitplane_t) + snapshot->plane_words * sizeof(uint64_t),
+                           size)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// Gives the piece of the mapped file MAPPED_REFERENCES references, whatever
+// the file keeps there, so the game never frees it or writes to it in place.
+static void attach_piece(atomic_uint_fast32_t* references) {
+    atomic_store_explicit(references, MAPPED_REFERENCES, memory_order_relaxed);
+}
+
+// Makes the game g, created by game_new with the parameters of the saved
+// game, use the pieces of the mapped file checked by correct_snapshot.
+// Returns false if the file does not fit the game or the allocation failed.
+static bool attach_snapshot(game_t* g, char* base, snapshot_t const* snapshot) {
+    uint64_t const* table = (uint64_t const*)(base + snapshot->tables_offset);
+
+    if ((snapshot->plane_words != 0) != (g->planes != NULL) ||
+        (g->planes && snapshot->plane_words != g->plane_words)) {
+        errno = EINVAL;
+        return false;
+    }
+
+    memcpy(g->all_players, base + snapshot->players_offset,
+           g->number_of_players * sizeof(player_t));
+    g->fields_to_take = snapshot->fields_to_take;
+    g->next_color = snapshot->next_color;
+    g->hash = snapshot->hash;
+
+    for (uint32_t i = 1; i <= g->number_of_players; i++) {
+        update_player_masks(g, i);
+    }
+
+    if (snapshot->number_of_area_blocks > 0) {
+        g->area_blocks = heap_allocate(g->heap, snapshot->number_of_area_blocks *
+                                         sizeof(area_block_t*), true);
+
+        if (!g->area_blocks) {
+            return false;
+        }
+
+        g->number_of_area_blocks = snapshot->number_of_area_blocks;
+    }
+
+    for (uint64_t i = 0; i < snapshot->number_of_area_blocks; i++) {
+        uint64_t offset = *table++;
+
+        if (offset != 0) {
+            g->area_blocks[i] = (area_block_t*)(base + offset);
+            attach_piece(&g->area_blocks[i]->references);
+            g->allocated_area_blocks++;
+        }
+    }
+
+    for (uint64_t i = 0; i < snapshot->number_of_tiles; i++, table += 2) {
+        uint64_t number = table[0] & ~SNAPSHOT_DENSE;
+        directory_t* directory = writable_directory(g, number >> DIRECTORY_SHIFT);
+
+        if (!directory) {
+            return false;
+        }
+        if (directory->tiles[number & DIRECTORY_MASK]) {
+            errno = EINVAL;
+            return false;
+        }
+
+        tile_t* tile = (tile_t*)(base + table[1]);
+
+        attach_piece(&tile->references);
+        directory->tiles[number & DIRECTORY_MASK] = tile;
+        g->allocated_tiles++;
+        g->dense_tiles += tile->length == TILE_DENSE;
+    }
+
+    for (uint32_t i = 0; i < g->number_of_players; i++) {
+        uint64_t offset = *table++;
+
+        if (offset != 0) {
+            g->frontiers[i] = (frontier_t*)(base + offset);
+            attach_piece(&g->frontiers[i]->references);
+        }
+    }
+
+    for (uint32_t i = 0; g->planes && i <= g->number_of_players; i++) {
+        uint64_t offset = *table++;
+
+        release_plane(g, g->planes[i]);
+        g->planes[i] = offset == 0 ? NULL : (bitplane_t*)(base + offset);
+
+        if (g->planes[i]) {
+            attach_piece(&g->planes[i]->references);
+        }
+    }
+
+    return true;
+}
+
+game_t* game_open_mapped(char const* path) {
+    if (!path) {
+        errno = EINVAL;
+        return NULL;
+    }
+
+    int descriptor = open(path, O_RDONLY);
+
+    if (descriptor < 0) {
+        return NULL;
+    }
+
+    struct stat status;
+    void* address = MAP_FAILED;
+
+    if (fstat(descriptor, &status) == 0) {
+        if ((uint64_t)status.st_size < sizeof(snapshot_t)) {
+            errno = EINVAL;
+        }
+        else {
+            address = mmap(NULL, (size_t)status.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                           descriptor, 0);
+        }
+    }
+
+    close(descriptor);
+
+    if (address == MAP_FAILED) {
+        return NULL;
+    }
+
+    snapshot_t const* snapshot = address;
+
+    if (!correct_snapshot(address, (uint64_t)status.st_size)) {
+        munmap(address, (size_t)status.st_size);
+        errno = EINVAL;
+
+        return NULL;
+    }
+
+    game_t* g = game_new((uint32_t)snapshot->width, (uint32_t)snapshot->height,
+                         (uint32_t)snapshot->players, (uint32_t)snapshot->areas);
+    size_t path_length = strlen(path) + 1;
+    mapping_t* mapping = !g ? NULL : heap_allocate(g->heap, sizeof(mapping_t), false);
+    char* copy = !mapping ? NULL : heap_allocate(g->heap, path_length, false);
+
+    if (!copy) {
+        munmap(address, (size_t)status.st_size);
+
+        if (g) {
+            heap_free(g->heap, mapping, sizeof(mapping_t));
+            game_delete(g);
+        }
+
+        errno = ENOMEM;
+
+        return NULL;
+    }
+
+    memcpy(copy, path, path_length);
+    atomic_init(&mapping->references, 1);
+    mapping->address = address;
+    mapping->length = (size_t)status.st_size;
+    mapping->path = copy;
+
+    // From now on the mapping is unmapped with the game.
+    g->mapping = mapping;
+
+    if (!attach_snapshot(g, address, snapshot)) {
+        int error = errno;
+        game_delete(g);
+        errno = error;
+
+        return NULL;
+    }
+
+    return g;
+}
+
+uint64_t game_hash(game_t const* g) {
+    return g ? g->hash : 0;
+}
+
+uint64_t game_busy_fields(game_t const* g, uint32_t player) {
+    if (!g || !correct_player_number(g, player)) {
+        return 0;
+    }
+
+    return g->all_players[player - 1].busy_fields;
+}
+
+uint64_t game_free_fields(game_t const* g, uint32_t player) {
+    if (!g || !correct_player_number(g, player)) {
+        return 0;
+    }
+    if (player_occupied_all_areas(g, player)) {
+        return g->all_players[player - 1].boundary_length;
+    }
+
+    return g->fields_to_take;
+}
+
+uint64_t game_general_free_fields(game_t const* g) {
+    return g->fields_to_take;
+}
+
+// Returns the number of bytes allocated for the frontiers of all players.
+static uint64_t frontiers_memory_usage(game_t const* g) {
+    uint64_t usage = g->number_of_players * sizeof(frontier_t*);
+
+    for (uint32_t i = 0; i < g->number_of_players; i++) {
+        if (g->frontiers[i]) {
+            usage += sizeof(frontier_t) + g->frontiers[i]->capacity * sizeof(uint64_t);
+        }
+    }
+
+    return usage;
+}
+
+// Returns the number of bytes allocated for the bitplanes.
+static uint64_t planes_memory_usage(game_t const* g) {
+    if (!g->planes) {
+        return 0;
+    }
+
+    uint64_t usage = (g->number_of_players + 1) * sizeof(bitplane_t*);
+
+    for (uint32_t i = 0; i <= g->number_of_players; i++) {
+        if (g->planes[i]) {
+            usage += sizeof(bitplane_t) + g->plane_words * sizeof(uint64_t);
+        }
+    }
+
+    return usage;
+}
+
+// Writes to moves the fields of the player marked in the words of the column
+// x starting from the row 64 * first, returns the new number of written moves.
+static uint64_t write_plane_moves(uint32_t player, uint32_t x, uint64_t first,
+                                  uint64_t const* words, uint64_t count, move_t* moves,
+                                  uint64_t written, uint64_t capacity) {
+    for (uint64_t i = 0; i < count && written < capacity; i++) {
+        for (uint64_t bits = words[i]; bits != 0 && written < capacity; bits &= bits - 1) {
+            moves[written].player = player;
+            moves[written].x = x;
+            moves[written].y = (uint32_t)(64 * (first + i) + (uint64_t)__builtin_ctzll(bits));
+            written++;
+        }
+    }
+
+    return written;
+}
+
+// The game_legal_moves for the boards with bitplanes, the fields are
+// written column by column.
+static uint64_t plane_legal_moves(game_t const* g, uint32_t player, move_t* moves,
+                                  uint64_t capacity) {
+    uint64_t column_words = g->plane_stride - 2;
+    uint64_t written = 0;
+
+    // A player without free areas may move only on the frontier.
+    if (player_occupied_all_areas(g, player)) {
+        uint64_t frontier[BITPLANE_CHUNK];
+
+        for (uint32_t x = 0; x < g->width && written < capacity; x++) {
+            for (uint64_t first = 0; first < column_words && written < capacity;
+                 first += BITPLANE_CHUNK) {
+                uint64_t count = column_words - first < BITPLANE_CHUNK ?
+                                 column_words - first : BITPLANE_CHUNK;
+
+                frontier_words(g, player, x, first, count, frontier);
+                written = write_plane_moves(player, x, first, frontier, count,
+                                            moves, written, capacity);
             }
-            else {
-                board[local_index] = g->all_players[player_number - 1].player_symbol;
+        }
+
+        return g->all_players[player - 1].boundary_length;
+    }
+
+    // Otherwise every free field is legal.
+    uint64_t free_fields[BITPLANE_CHUNK];
+    uint64_t const* occupied = g->planes[0]->words;
+
+    for (uint32_t x = 0; x < g->width && written < capacity; x++) {
+        for (uint64_t first = 0; first < column_words && written < capacity;
+             first += BITPLANE_CHUNK) {
+            uint64_t count = column_words - first < BITPLANE_CHUNK ?
+                             column_words - first : BITPLANE_CHUNK;
+
+            for (uint64_t i = 0; i < count; i++) {
+                free_fields[i] = ~occupied[plane_word(g, x, 0) + first + i];
             }
 
-            local_index++;
+            written = write_plane_moves(player, x, first, free_fields, count,
+                                        moves, written, capacity);
         }
+    }
 
-        board[local_index] = '\n';
-        local_index++;
+    return g->fields_to_take;
+}
+
+uint64_t game_legal_moves(game_t const* g, uint32_t player, move_t* moves, uint64_t capacity) {
+    if (!g || !correct_player_number(g, player)) {
+        return 0;
+    }
+    if (g->planes) {
+        return plane_legal_moves(g, player, moves, capacity);
     }
 
-    board[size - 1] = '\0';
+    uint64_t written = 0;
 
-    return board;
+    // A player without free areas may move only on the frontier.
+    if (player_occupied_all_areas(g, player)) {
+        frontier_t const* frontier = g->frontiers[player - 1];
+
+        for (uint64_t i = 0; frontier && i < frontier->capacity && written < capacity; i++) {
+            uint64_t index = frontier->fields[i];
+
+            if (index != FRONTIER_EMPTY) {
+                moves[written].player = player;
+                moves[written].x = (uint32_t)(index / g->height);
+                moves[written].y = (uint32_t)(index % g->height);
+                written++;
+            }
+        }
+
+        return g->all_players[player - 1].boundary_length;
+    }
+
+    // Otherwise every free field is legal, the board is scanned only
+    // until the array is full.
+    for (uint32_t x = 0; x < g->width && written < capacity; x++) {
+        for (uint32_t y = 0; y < g->height && written < capacity; y++) {
+            if (empty_coordinate(g, x, y)) {
+                moves[written].player = player;
+                moves[written].x = x;
+                moves[written].y = y;
+                written++;
+            }
+        }
+    }
+
+    return g->fields_to_take;
 }
 
-/** @brief  Checks if the player can make any move on the game
- * board. This function is an auxiliary function in find_next_player
- * function.
- * @param g                 - pointer on the game structure.
- * @param player_number     - number of observed player.
- * @return True if the player can make any move and false otherwise.
- */
-static bool player_available(game_t* g, uint32_t player_number) {
-    if (game_free_fields(g, player_number) > 0) {
+uint64_t game_memory_usage(game_t const* g) {
+    if (!g) {
+        return 0;
+    }
+
+    return sizeof(game_t) +
+           g->number_of_players * sizeof(player_t) +
+           g->number_of_directories * sizeof(directory_t*) +
+           g->allocated_directories * sizeof(directory_t) +
+           g->dense_tiles * DENSE_TILE_SIZE +
+           (g->allocated_tiles - g->dense_tiles) * SPARSE_TILE_SIZE +
+           g->number_of_area_blocks * sizeof(area_block_t*) +
+           g->allocated_area_blocks * sizeof(area_block_t) +
+           (g->journal_capacity + g->redo_capacity) * sizeof(uint64_t) +
+           frontiers_memory_usage(g) + planes_memory_usage(g);
+}
+
+bool game_stats(game_t const* g, game_stats_t* stats) {
+    if (!stats) {
+        return false;
+    }
+
+#ifdef GAME_STATS
+    if (g) {
+        *stats = g->stats;
+
         return true;
     }
+#endif
+
+    (void)g;
+    memset(stats, 0, sizeof(game_stats_t));
 
     return false;
 }
 
-bool find_next_player(game_t* g, uint32_t* current_player_number) {
-    uint32_t find_next = *current_player_number;
+uint32_t game_board_width(game_t const *g) {
+    if (!g) {
+        return 0;
+    }
 
-    // If the next player is found then this variable is true.
-    bool search_success = false;
+    return g->width;
+}
 
-    // Set find_next to the next player after current_player_number.
-    if (find_next == game_players(g)) {
-        find_next = 1;
+uint32_t game_board_height(game_t const *g) {
+    if (!g) {
+        return 0;
     }
-    else {
-        find_next++;
+
+    return g->height;
+}
+
+uint32_t game_areas(game_t const* g) {
+    return g->max_areas;
+}
+
+uint32_t game_players(game_t const *g) {
+    if (!g) {
+        return 0;
+    }
+
+    return g->number_of_players;
+}
+
+char game_player(game_t const* g, uint32_t player) {
+    if (!g || !correct_player_number(g, player)) {
+        return '.';
+    }
+
+    return g->all_players[player - 1].player_symbol;
+}
+
+// Fills the array of symbols of all player numbers, the symbol of
+// the empty field is at the index zero.
+static void fill_symbols(game_t const* g, char* symbols) {
+    symbols[0] = '.';
+
+    for (uint32_t i = 0; i < g->number_of_players; i++) {
+        symbols[i + 1] = g->all_players[i].player_symbol;
     }
+}
 
-    // Find next available player for making a move.
-    while (find_next != *current_player_number) {
-        if (player_available(g, find_next)) {
-            *current_player_number = find_next;
-            search_success = true;
+// Writes the symbols of length fields of the row y starting from
+// the column x to the array row.
+static void fill_row(game_t const* g, char const* symbols, uint32_t y, uint32_t x,
+                     uint64_t length, char* row) {
+    uint64_t end = (uint64_t)x + length;
+
+    // The fields are read one tile at a time, an unallocated tile is empty.
+    while (x < end) {
+        uint64_t next = ((uint64_t)(x >> TILE_SHIFT) + 1) << TILE_SHIFT;
+        uint32_t stop = (uint32_t)(next < end ? next : end);
+        tile_t const* tile = find_tile(g, x, y);
+
+        if (!tile) {
+            memset(row, '.', stop - x);
+            row += stop - x;
+            x = stop;
+            continue;
+        }
+
+        uint8_t const* players = tile_players(tile);
+
+        if (tile->length == TILE_DENSE) {
+            for (; x < stop; x++) {
+                *row++ = symbols[players[tile_index(x, y)]];
+            }
 
-            return search_success;
+            continue;
         }
-        else if (find_next == game_players(g)) {
-            find_next = 1;
+
+        // Only the busy fields of a sparse tile are read.
+        memset(row, '.', stop - x);
+
+        for (uint32_t i = 0; i < tile->length; i++) {
+            uint32_t index = sparse_indices(tile)[i];
+            uint32_t column = (x & ~TILE_MASK) | (index >> TILE_SHIFT);
+
+            if ((index & TILE_MASK) == (y & TILE_MASK) && column >= x && column < stop) {
+                row[column - x] = symbols[players[i]];
+            }
         }
-        else {
-            find_next++;
+
+        row += stop - x;
+        x = stop;
+    }
+}
+
+char* game_board(game_t const *g) {
+    if (!g) {
+        return NULL;
+    }
+
+    uint64_t size = ((uint64_t)g->width + 1) * (uint64_t )g->height + 1;
+    char* board = (char*)malloc(size * sizeof(char));
+    uint64_t local_index = 0;
+    char symbols[MAX_PLAYERS + 1];
+
+    if (!board) {
+      return NULL;
+    }
+
+    fill_symbols(g, symbols);
+
+    for (uint32_t i = g->height; i-- > 0;) {
+        fill_row(g, symbols, i, 0, g->width, board + local_index);
+        local_index += g->width;
+        board[local_index] = '\n';
+        local_index++;
+    }
+
+    board[size - 1] = '\0';
+
+    return board;
+}
+
+bool game_board_rows(game_t const* g, game_row_callback_t callback, void* data) {
+    if (!g) {
+        return false;
+    }
+
+    return game_board_region(g, 0, 0, g->width, g->height, callback, data);
+}
+
+bool game_board_region(game_t const* g, uint32_t x0, uint32_t y0, uint32_t width,
+                       uint32_t height, game_row_callback_t callback, void* data) {
+    if (!g || !callback || (uint64_t)x0 + width > g->width ||
+        (uint64_t)y0 + height > g->height) {
+        return false;
+    }
+
+    char symbols[MAX_PLAYERS + 1];
+    char chunk[GAME_BOARD_CHUNK];
+    uint32_t x_end = x0 + width;
+
+    fill_symbols(g, symbols);
+
+    for (uint32_t i = y0 + height; i-- > y0;) {
+        for (uint32_t j = x0; j < x_end;) {
+            uint32_t length = x_end - j < GAME_BOARD_CHUNK ? x_end - j : GAME_BOARD_CHUNK;
+
+            fill_row(g, symbols, i, j, length, chunk);
+
+            if (!callback(data, i, j, chunk, length)) {
+                return false;
+            }
+
+            j += length;
         }
     }
 
-    // If there is no available players except of
-    // current_player_number we need to check him again.
-    if (player_available(g, *current_player_number)) {
-        search_success = true;
+    return true;
+}
+
+/** @brief The state of game_board_write:
+ * file            - the written file,
+ * width           - the width of the board.
+ */
+typedef struct Board_writer {
+    FILE* file;
+    uint32_t width;
+} board_writer_t;
+
+// Writes one fragment of a row for game_board_write, ends the row with
+// the new line character.
+static bool write_row(void* data, uint32_t y, uint32_t x, char const* symbols,
+                      size_t length) {
+    board_writer_t* writer = data;
+
+    (void)y;
+
+    if (fwrite(symbols, 1, length, writer->file) != length) {
+        return false;
+    }
+    if (x + length == writer->width && putc('\n', writer->file) == EOF) {
+        return false;
+    }
+
+    return true;
+}
+
+bool game_board_write(game_t const* g, FILE* file) {
+    if (!g || !file) {
+        return false;
+    }
+
+    board_writer_t writer = {file, g->width};
+
+    return game_board_rows(g, write_row, &writer) && !ferror(file);
+}
+
+bool game_is_over(game_t const* g) {
+    return !g || movable_players(g) == 0;
+}
+
+bool find_next_player(game_t* g, uint32_t* current_player_number) {
+    uint64_t movable = movable_players(g);
+    uint32_t current = *current_player_number;
+
+    if (movable == 0) {
+        return false;
     }
 
-    return search_success;
+    // The players after the current one are looked for first, then
+    // the search starts again from the first player (and may find
+    // the current player if nobody else can move).
+    uint64_t later = current < MAX_PLAYERS ? movable >> current << current : 0;
+
+    *current_player_number = (uint32_t)__builtin_ctzll(later ? later : movable) + 1;
+
+    return true;
 }
 
 void print_players_score(game_t* g) {
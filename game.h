@@ -6,8 +6,26 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+/**
+ * Opis jednego ruchu: gracz @p player stawia pionek na polu (@p x, @p y).
+ */
+typedef struct move {
+    uint32_t player;
+    uint32_t x;
+    uint32_t y;
+} move_t;
+
 /**
  * To jest deklaracja struktury przechowującej stan gry.
+ *
+ * Cały stan gry jest przechowywany w tej strukturze, więc różne gry
+ * utworzone w jednym procesie są od siebie niezależne i mogą być
+ * obsługiwane równolegle przez różne wątki. Dla jednej gry obowiązują
+ * zasady opisane przy każdej funkcji:
+ * - funkcja odczytująca może być wywoływana współbieżnie z innymi funkcjami
+ *   odczytującymi tę samą grę,
+ * - funkcja modyfikująca nie może być wywoływana współbieżnie z żadną inną
+ *   funkcją dla tej samej gry.
  */
 typedef struct game game_t;
 
@@ -22,17 +40,143 @@ typedef struct game game_t;
  *                      gracz, liczba dodatnia.
  * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się alokować
  * pamięci lub któryś z parametrów jest niepoprawny.
+ * @note Dla małych plansz gra przechowuje dodatkowo mapy bitowe pól każdego
+ * gracza i pól zajętych, z których funkcja @ref game_legal_moves wylicza
+ * pola sąsiadujące z pionkami gracza. Wariant jest wybierany na podstawie
+ * rozmiaru planszy i liczby graczy, wyniki pozostałych funkcji od niego nie
+ * zależą.
+ * @note Wątki: różne wątki mogą jednocześnie tworzyć nowe gry.
  */
 game_t* game_new(uint32_t width, uint32_t height,
                  uint32_t players, uint32_t areas);
 
+/**
+ * Alokator pamięci gry, zob. @ref game_new_ex:
+ * - @p allocate – przydziela @p size bajtów wyrównanych dla dowolnego typu
+ *   i zwraca wskaźnik na nie lub NULL, gdy brakuje pamięci,
+ * - @p deallocate – zwalnia blok @p pointer o rozmiarze @p size przydzielony
+ *   przez @p allocate,
+ * - @p context – wskaźnik przekazywany obu funkcjom,
+ * - @p budget – maksymalna liczba bajtów przydzielonych jednocześnie grze
+ *   i wszystkim jej kopiom, zero oznacza brak limitu.
+ *
+ * Gdy @p allocate ma wartość NULL, gra używa funkcji @p malloc i @p free,
+ * ale przestrzega limitu @p budget.
+ */
+typedef struct game_allocator {
+    void *(*allocate)(void *context, size_t size);
+    void (*deallocate)(void *context, void *pointer, size_t size);
+    void *context;
+    uint64_t budget;
+} game_allocator_t;
+
+/** @brief Tworzy strukturę przechowującą stan gry we wskazanej pamięci.
+ * Działa jak @ref game_new, ale całą pamięć gry, także pamięć jej kopii
+ * utworzonych funkcją @ref game_clone, przydziela alokator @p allocator.
+ * Ruch, który przekroczyłby limit pamięci alokatora, nie jest wykonywany,
+ * a funkcja ustawia @p errno na @p ENOMEM.
+ * @param[in] width     – szerokość planszy, liczba dodatnia,
+ * @param[in] height    – wysokość planszy, liczba dodatnia,
+ * @param[in] players   – liczba graczy, liczba dodatnia,
+ * @param[in] areas     – maksymalna liczba obszarów, które może zająć jeden
+ *                        gracz, liczba dodatnia,
+ * @param[in] allocator – wskaźnik na alokator, który jest kopiowany, lub NULL
+ *                        dla funkcji @p malloc i @p free bez limitu.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się alokować
+ * pamięci lub któryś z parametrów jest niepoprawny.
+ * @note Wątki: różne wątki mogą jednocześnie tworzyć nowe gry. Gra i jej kopie
+ * mogą wywoływać funkcje alokatora z różnych wątków.
+ */
+game_t* game_new_ex(uint32_t width, uint32_t height, uint32_t players,
+                    uint32_t areas, game_allocator_t const *allocator);
+
+/** @brief Tworzy alokator przydzielający pamięć z jednego ciągłego obszaru.
+ * Bloki są przydzielane kolejno od początku obszaru, a zwolnienie bloku
+ * odzyskuje jego pamięć tylko wtedy, gdy był on przydzielony jako ostatni.
+ * Gra utworzona funkcją @ref game_new_ex z tym alokatorem zajmuje więc jeden
+ * spójny fragment pamięci.
+ * @param[in] size    – rozmiar obszaru w bajtach.
+ * @return Wskaźnik na alokator, który należy usunąć funkcją
+ * @ref game_arena_delete po usunięciu wszystkich używających go gier, lub NULL,
+ * gdy nie udało się alokować pamięci.
+ * @note Wątki: alokator może być używany przez różne wątki jednocześnie.
+ */
+game_allocator_t* game_arena_new(size_t size);
+
+/** @brief Usuwa alokator utworzony funkcją @ref game_arena_new razem z jego
+ * obszarem pamięci. Nic nie robi, jeśli wskaźnik ma wartość NULL.
+ * @param[in] arena   – wskaźnik na usuwany alokator.
+ */
+void game_arena_delete(game_allocator_t *arena);
+
 /** @brief Usuwa strukturę przechowującą stan gry.
  * Usuwa z pamięci strukturę wskazywaną przez @p g.
  * Nic nie robi, jeśli wskaźnik ten ma wartość NULL.
  * @param[in] g       – wskaźnik na usuwaną strukturę.
+ * @note Wątki: funkcja modyfikująca.
  */
 void game_delete(game_t* g);
 
+/** @brief Przywraca początkowy stan gry.
+ * Zwalnia wszystkie pola planszy i zeruje wyniki graczy, tak że gra jest
+ * w takim stanie, w jakim zwróciła ją funkcja @ref game_new z tymi samymi
+ * parametrami. Zajęta pamięć jest zachowywana dla kolejnej gry, więc koszt
+ * jest proporcjonalny do liczby zajętych wcześniej fragmentów planszy, a nie
+ * do jej rozmiaru. Dziennik ruchów jest czyszczony, ale pozostaje włączony,
+ * jeśli był włączony, a liczniki @ref game_stats są zerowane.
+ * Gdy nie udało się alokować pamięci, ustawia @p errno na @p ENOMEM.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry.
+ * @return Wartość @p true, jeśli stan gry został przywrócony, a @p false,
+ * gdy nie udało się alokować pamięci (wtedy grę można tylko usunąć) lub
+ * wskaźnik @p g ma wartość NULL.
+ * @note Wątki: funkcja modyfikująca.
+ */
+bool game_reset(game_t *g);
+
+/**
+ * To jest deklaracja puli gier gotowych do ponownego użycia.
+ */
+typedef struct game_pool game_pool_t;
+
+/** @brief Tworzy pulę gier.
+ * @param[in] capacity – maksymalna liczba gier przechowywanych w puli.
+ * @return Wskaźnik na pustą pulę lub NULL, gdy nie udało się alokować pamięci.
+ */
+game_pool_t* game_pool_new(size_t capacity);
+
+/** @brief Usuwa pulę gier razem ze wszystkimi przechowywanymi w niej grami.
+ * Nic nie robi, jeśli wskaźnik @p pool ma wartość NULL.
+ * @param[in] pool    – wskaźnik na usuwaną pulę.
+ */
+void game_pool_delete(game_pool_t *pool);
+
+/** @brief Podaje grę w stanie początkowym.
+ * Wyjmuje z puli grę o podanych parametrach, a gdy takiej nie ma, tworzy
+ * nową funkcją @ref game_new.
+ * @param[in,out] pool – wskaźnik na pulę lub NULL,
+ * @param[in] width   – szerokość planszy, liczba dodatnia,
+ * @param[in] height  – wysokość planszy, liczba dodatnia,
+ * @param[in] players – liczba graczy, liczba dodatnia,
+ * @param[in] areas   – maksymalna liczba obszarów, które może zająć jeden
+ *                      gracz, liczba dodatnia.
+ * @return Wskaźnik na grę, którą należy oddać funkcją @ref game_pool_put lub
+ * usunąć funkcją @ref game_delete, albo NULL, tak jak w @ref game_new.
+ */
+game_t* game_pool_get(game_pool_t *pool, uint32_t width, uint32_t height,
+                      uint32_t players, uint32_t areas);
+
+/** @brief Oddaje grę do puli.
+ * Przywraca początkowy stan gry funkcją @ref game_reset i zachowuje ją dla
+ * kolejnego wywołania @ref game_pool_get. Gdy pula jest pełna, usuwa z niej
+ * najdawniej oddaną grę. Gdy wskaźnik @p pool ma wartość NULL lub nie udało
+ * się przywrócić stanu gry, usuwa grę.
+ * @param[in,out] pool – wskaźnik na pulę lub NULL,
+ * @param[in] g       – wskaźnik na oddawaną grę lub NULL.
+ * @note Wątki: pula nie może być używana przez różne wątki jednocześnie,
+ * każdy wątek powinien mieć własną pulę.
+ */
+void game_pool_put(game_pool_t *pool, game_t *g);
+
 /** @brief Wykonuje ruch.
  * Ustawia pionek gracza @p player na polu (@p x, @p y).
  * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
@@ -45,9 +189,215 @@ void game_delete(game_t* g);
  * @return Wartość @p true, jeśli ruch został wykonany, a @p false,
  * gdy ruch jest nielegalny, któryś z parametrów jest niepoprawny lub
  * wskaźnik @p g ma wartość NULL.
+ * @note Wątki: funkcja modyfikująca.
  */
 bool game_move(game_t *g, uint32_t player, uint32_t x, uint32_t y);
 
+/** @brief Wykonuje ciąg ruchów.
+ * Wykonuje kolejno ruchy z tablicy @p moves, tak jak kolejne wywołania
+ * funkcji @ref game_move, ale sprawdza wspólne parametry tylko raz.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] moves   – tablica ruchów,
+ * @param[in] n       – liczba ruchów,
+ * @param[out] results – tablica długości @p n, do której są wpisywane wyniki
+ *                      ruchów: 1, jeśli ruch został wykonany, a 0 w przeciwnym
+ *                      przypadku, lub NULL, jeśli wyniki nie są potrzebne.
+ * @return Liczba wykonanych ruchów lub zero, gdy wskaźnik @p g ma wartość NULL.
+ * @note Wątki: funkcja modyfikująca.
+ */
+size_t game_move_batch(game_t *g, move_t const *moves, size_t n, uint8_t *results);
+
+/** @brief Włącza lub wyłącza tryb współbieżny.
+ * W trybie współbieżnym wiele wątków może jednocześnie wykonywać ruchy
+ * w tej samej grze funkcją @ref game_move_concurrent. Plansza jest podzielona
+ * na regiony z osobnymi blokadami, a ruch blokuje tylko regiony pól
+ * w odległości co najwyżej 2 od zajmowanego pola, swojego gracza i graczy
+ * sąsiednich pól oraz, gdy łączy obszary, strukturę obszarów. Ruchy
+ * w odległych częściach planszy nie czekają więc na siebie. Włączenie trybu
+ * alokuje struktury całej planszy (8 bajtów na każde 4096 pól), dlatego
+ * jest niemożliwe dla bardzo dużych plansz. Wyłączenie trybu uzupełnia
+ * liczniki gry, których ruchy współbieżne nie zmieniały, więc wyniki
+ * pozostałych funkcji są takie, jakby ruchy wykonano kolejno funkcją
+ * @ref game_move.
+ * Gdy nie udało się alokować pamięci, ustawia @p errno na @p ENOMEM.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] enabled – @p true, aby włączyć tryb, @p false, aby go wyłączyć.
+ * @return Wartość @p true, jeśli tryb został włączony lub wyłączony,
+ * a @p false, gdy nie udało się alokować pamięci, dziennik ruchów jest
+ * włączony (zob. @ref game_set_journal, wtedy @p errno ma wartość @p EINVAL)
+ * lub wskaźnik @p g ma wartość NULL.
+ * @note Wątki: funkcja modyfikująca. Dopóki tryb jest włączony, gra może być
+ * zmieniana tylko funkcją @ref game_move_concurrent i nie wolno wywoływać dla
+ * niej innych funkcji, także odczytujących, poza @ref game_set_concurrent.
+ * Alokator gry (zob. @ref game_new_ex) musi być bezpieczny dla wątków.
+ */
+bool game_set_concurrent(game_t *g, bool enabled);
+
+/** @brief Wykonuje ruch w trybie współbieżnym.
+ * Działa jak @ref game_move, ale może być wywoływana jednocześnie przez wiele
+ * wątków, zob. @ref game_set_concurrent. Ruchy wykonane jednocześnie dają taki
+ * stan gry, jakby wykonano je kolejno w pewnej kolejności.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza, liczba dodatnia niewiększa od wartości
+ *                      @p players z funkcji @ref game_new,
+ * @param[in] x       – numer kolumny, liczba nieujemna mniejsza od wartości
+ *                      @p width z funkcji @ref game_new,
+ * @param[in] y       – numer wiersza, liczba nieujemna mniejsza od wartości
+ *                      @p height z funkcji @ref game_new.
+ * @return Wartość @p true, jeśli ruch został wykonany, a @p false,
+ * gdy ruch jest nielegalny, któryś z parametrów jest niepoprawny, tryb
+ * współbieżny jest wyłączony lub wskaźnik @p g ma wartość NULL.
+ * @note Wątki: może być wywoływana jednocześnie z innymi wywołaniami tej
+ * funkcji dla tej samej gry.
+ */
+bool game_move_concurrent(game_t *g, uint32_t player, uint32_t x, uint32_t y);
+
+/** @brief Skutek ruchu obliczony przez @ref game_move_preview:
+ * - @p legal – wartość @p true, jeśli ruch jest legalny,
+ * - @p areas – zmiana liczby obszarów gracza: 1 dla nowego obszaru, 0 dla
+ *   pola dołączonego do jednego obszaru i ujemna, gdy ruch łączy obszary,
+ * - @p boundary – zmiana liczby wolnych pól sąsiadujących z pionkami gracza,
+ * - @p opponents – numery przeciwników, z których każdy traci jedno wolne pole
+ *   sąsiadujące z jego pionkami (zajmowane pole),
+ * - @p opponents_length – liczba tych przeciwników.
+ *
+ * Dla ruchu nielegalnego wszystkie pola mają wartość zero.
+ */
+typedef struct move_effect {
+    bool legal;
+    int32_t areas;
+    int64_t boundary;
+    uint32_t opponents[4];
+    uint32_t opponents_length;
+} move_effect_t;
+
+/** @brief Oblicza skutek ruchu bez jego wykonania.
+ * Sprawdza, co zmieniłoby wywołanie @ref game_move z tymi samymi parametrami,
+ * nie zmieniając stanu gry. Czas działania jest stały.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player  – numer gracza, liczba dodatnia niewiększa od wartości
+ *                      @p players z funkcji @ref game_new,
+ * @param[in] x       – numer kolumny, liczba nieujemna mniejsza od wartości
+ *                      @p width z funkcji @ref game_new,
+ * @param[in] y       – numer wiersza, liczba nieujemna mniejsza od wartości
+ *                      @p height z funkcji @ref game_new,
+ * @param[out] effect – wskaźnik na strukturę, do której jest wpisywany skutek
+ *                      ruchu, lub NULL, jeśli potrzebna jest tylko legalność.
+ * @return Wartość @p true, jeśli ruch jest legalny, a @p false, gdy ruch jest
+ * nielegalny, któryś z parametrów jest niepoprawny lub wskaźnik @p g ma
+ * wartość NULL.
+ * @note Wątki: funkcja odczytująca, więc różne wątki mogą jednocześnie oceniać
+ * ruchy w tej samej grze.
+ */
+bool game_move_preview(game_t const *g, uint32_t player, uint32_t x, uint32_t y,
+                       move_effect_t *effect);
+
+/** @brief Tworzy kopię gry.
+ * Kopia współdzieli z grą @p g fragmenty planszy oraz struktury opisujące
+ * obszary. Fragment jest kopiowany dopiero wtedy, gdy jedna z gier po raz
+ * pierwszy go zmienia, więc koszt utworzenia kopii nie zależy od rozmiaru
+ * planszy, a dalsze ruchy kosztują tyle, ile zmienionych fragmentów.
+ * Kopia ma pusty dziennik ruchów (zob. @ref game_set_journal), dziennik jest
+ * włączony, jeśli był włączony w grze @p g.
+ * Gdy nie udało się alokować pamięci, ustawia @p errno na @p ENOMEM.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
+ * @return Wskaźnik na kopię gry, którą należy usunąć funkcją @ref game_delete,
+ * lub NULL, gdy nie udało się alokować pamięci lub wskaźnik @p g ma wartość
+ * NULL.
+ * @note Wątki: funkcja odczytująca. Gra i jej kopie są niezależne, więc mogą
+ * być używane przez różne wątki jednocześnie.
+ */
+game_t* game_clone(game_t const *g);
+
+/** @brief Włącza lub wyłącza dziennik ruchów.
+ * Gdy dziennik jest włączony, każdy wykonany ruch jest w nim zapisywany
+ * (kilkanaście bajtów na ruch), co pozwala go cofnąć funkcją @ref game_undo.
+ * Każde wywołanie czyści dziennik i stos ruchów do powtórzenia, więc nie
+ * można cofnąć ruchów wykonanych przed włączeniem dziennika.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] enabled – @p true, aby włączyć dziennik, @p false, aby go wyłączyć.
+ * @note Wątki: funkcja modyfikująca.
+ */
+void game_set_journal(game_t *g, bool enabled);
+
+/** @brief Cofa ostatni ruch.
+ * Przywraca stan gry sprzed ostatniego ruchu zapisanego w dzienniku, kosztem
+ * porównywalnym z kosztem samego ruchu. Cofnięty ruch można powtórzyć funkcją
+ * @ref game_redo, dopóki nie zostanie wykonany nowy ruch funkcją @ref game_move.
+ * Gdy nie udało się alokować pamięci, ustawia @p errno na @p ENOMEM.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry.
+ * @return Wartość @p true, jeśli ruch został cofnięty, a @p false, gdy dziennik
+ * jest pusty, nie udało się alokować pamięci lub wskaźnik @p g ma wartość NULL.
+ * @note Wątki: funkcja modyfikująca.
+ */
+bool game_undo(game_t *g);
+
+/** @brief Powtarza ostatni cofnięty ruch.
+ * Gdy nie udało się alokować pamięci, ustawia @p errno na @p ENOMEM.
+ * @param[in,out] g   – wskaźnik na strukturę przechowującą stan gry.
+ * @return Wartość @p true, jeśli ruch został powtórzony, a @p false, gdy nie ma
+ * cofniętych ruchów, nie udało się alokować pamięci lub wskaźnik @p g ma
+ * wartość NULL.
+ * @note Wątki: funkcja modyfikująca.
+ */
+bool game_redo(game_t *g);
+
+/** @brief Zapisuje stan gry do pliku.
+ * Zapisuje planszę, graczy i obszary w formacie, który funkcja
+ * @ref game_open_mapped odwzorowuje w pamięci bez czytania całego pliku.
+ * Plik jest najpierw zapisywany pod nazwą z przyrostkiem ".tmp", a potem
+ * zastępuje plik @p path, więc przerwany zapis nie psuje poprzedniego stanu.
+ * Dziennik ruchów i liczniki @ref game_stats nie są zapisywane.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] path    – nazwa pliku.
+ * @return Wartość @p true, jeśli stan został zapisany, a @p false, gdy
+ * wystąpił błąd (wtedy @p errno opisuje błąd) lub któryś ze wskaźników ma
+ * wartość NULL.
+ * @note Wątki: funkcja odczytująca.
+ */
+bool game_save(game_t const *g, char const *path);
+
+/** @brief Otwiera grę zapisaną w pliku.
+ * Odwzorowuje plik zapisany funkcją @ref game_save w pamięci, tak że system
+ * wczytuje tylko używane fragmenty planszy. Czas otwarcia zależy od liczby
+ * zapisanych fragmentów, a nie od rozmiaru planszy. Każdy fragment jest przy
+ * tym sprawdzany, więc uszkodzony plik jest odrzucany. Fragment zmieniany przez
+ * ruch jest najpierw kopiowany, więc plik zmienia się tylko przez funkcje
+ * @ref game_save i @ref game_sync.
+ * @param[in] path    – nazwa pliku.
+ * @return Wskaźnik na grę, którą należy usunąć funkcją @ref game_delete,
+ * lub NULL, gdy nie udało się otworzyć pliku, ma on niepoprawny format lub
+ * wersję albo jest uszkodzony (wtedy @p errno ma wartość @p EINVAL) lub nie
+ * udało się alokować pamięci.
+ * @note Wątki: różne wątki mogą jednocześnie otwierać gry.
+ */
+game_t* game_open_mapped(char const *path);
+
+/** @brief Zapisuje stan gry do pliku, z którego została otwarta.
+ * Działa jak @ref game_save z nazwą pliku podaną funkcji
+ * @ref game_open_mapped dla tej gry lub gry, której jest kopią.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
+ * @return Wartość @p true, jeśli stan został zapisany, a @p false, gdy
+ * wystąpił błąd zapisu, gra nie została otwarta z pliku (wtedy @p errno ma
+ * wartość @p EINVAL) lub wskaźnik @p g ma wartość NULL.
+ * @note Wątki: funkcja odczytująca.
+ */
+bool game_sync(game_t const *g);
+
+/** @brief Podaje skrót stanu gry.
+ * Podaje 64-bitowy skrót Zobrista planszy, czyli różnicę symetryczną (xor)
+ * kluczy wszystkich zajętych pól, gdzie klucz zależy od pola i gracza.
+ * Obszary graczy wynikają z planszy, więc dwie gry o tych samych
+ * parametrach z takim samym skrótem mają (z dużym prawdopodobieństwem) ten sam
+ * stan, niezależnie od kolejności ruchów, które do niego doprowadziły.
+ * Skrót jest aktualizowany w czasie stałym przy każdym ruchu i jego cofnięciu.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
+ * @return Skrót stanu gry, zero dla pustej planszy lub gdy wskaźnik @p g ma
+ * wartość NULL.
+ * @note Wątki: funkcja odczytująca.
+ */
+uint64_t game_hash(game_t const *g);
+
 /** @brief Podaje liczbę pól zajętych przez gracza.
  * Podaje liczbę pól zajętych przez gracza @p player.
  * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
@@ -55,6 +405,7 @@ bool game_move(game_t *g, uint32_t player, uint32_t x, uint32_t y);
  *                      @p players z funkcji @ref game_new.
  * @return Liczba pól zajętych przez gracza lub zero,
  * jeśli któryś z parametrów jest niepoprawny lub wskaźnik @p g ma wartość NULL.
+ * @note Wątki: funkcja odczytująca.
  */
 uint64_t game_busy_fields(game_t const *g, uint32_t player);
 
@@ -66,24 +417,91 @@ uint64_t game_busy_fields(game_t const *g, uint32_t player);
  *                      @p players z funkcji @ref game_new.
  * @return Liczba pól, jakie jeszcze może zająć gracz lub zero,
  * jeśli któryś z parametrów jest niepoprawny lub wskaźnik @p g ma wartość NULL.
+ * @note Wątki: funkcja odczytująca.
  */
 uint64_t game_free_fields(game_t const *g, uint32_t player);
 
+/** @brief Podaje pola, na których gracz może postawić pionek.
+ * Wpisuje do tablicy @p moves co najwyżej @p capacity ruchów gracza
+ * @p player, które są legalne w danym stanie gry. Gdy gracz zajął już
+ * wszystkie obszary, legalne są tylko wolne pola sąsiadujące z jego pionkami.
+ * Gra przechowuje zbiór tych pól dla każdego gracza, więc czas działania jest
+ * proporcjonalny do jego rozmiaru, a nie do rozmiaru planszy (dla małych plansz
+ * pola są wyliczane z map bitowych po 64 naraz). W przeciwnym
+ * przypadku legalne jest każde wolne pole i plansza jest przeglądana tylko
+ * do zapełnienia tablicy.
+ * @param[in] g        – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player   – numer gracza, liczba dodatnia niewiększa od wartości
+ *                       @p players z funkcji @ref game_new,
+ * @param[out] moves   – tablica, do której są wpisywane ruchy,
+ * @param[in] capacity – długość tablicy @p moves.
+ * @return Liczba wszystkich legalnych ruchów gracza (równa wynikowi funkcji
+ * @ref game_free_fields), która może być większa od liczby wpisanych ruchów,
+ * lub zero, jeśli któryś z parametrów jest niepoprawny lub wskaźnik @p g ma
+ * wartość NULL.
+ * @note Wątki: funkcja odczytująca.
+ */
+uint64_t game_legal_moves(game_t const *g, uint32_t player, move_t *moves,
+                          uint64_t capacity);
+
 /** @brief Podaje liczbę pól, które są wolne.
  * @param[in] g     - wskaźnik na strukturę przechowującą stan gry.
  * @return Liczbę wolnych pól na planszy.
+ * @note Wątki: funkcja odczytująca.
  */
 uint64_t game_general_free_fields(game_t const *g);
 
+/** @brief Podaje rozmiar pamięci zajmowanej przez grę.
+ * Uwzględnia strukturę gry, planszę, tablicę graczy oraz struktury
+ * opisujące obszary. Kolory pól są alokowane dopiero przy zajęciu
+ * pierwszego pola w danym fragmencie planszy, więc wynik rośnie w trakcie gry.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
+ * @return Liczba bajtów zaalokowanych przez grę lub zero, gdy wskaźnik @p g
+ * ma wartość NULL.
+ * @note Wątki: funkcja odczytująca.
+ */
+uint64_t game_memory_usage(game_t const *g);
+
+/**
+ * Liczniki zdarzeń wewnątrz silnika gry, zob. @ref game_stats.
+ * Liczone są od utworzenia gry funkcją @ref game_new lub @ref game_clone.
+ */
+typedef struct game_stats {
+    uint64_t new_area_moves;        ///< Ruchy tworzące nowy obszar.
+    uint64_t boundary_moves;        ///< Ruchy dołączające pole do obszarów gracza.
+    uint64_t rejected_invalid;      ///< Ruchy z niepoprawnym graczem lub polem.
+    uint64_t rejected_busy;         ///< Ruchy na zajęte pole.
+    uint64_t rejected_areas;        ///< Ruchy przekraczające limit obszarów.
+    uint64_t rejected_memory;       ///< Ruchy odrzucone z braku pamięci.
+    uint64_t area_unions;           ///< Połączenia dwóch obszarów.
+    uint64_t area_finds;            ///< Wyszukiwania reprezentanta obszaru.
+    uint64_t area_find_steps;       ///< Krawędzie przebyte przy tych wyszukiwaniach.
+    uint64_t neighbour_lookups;     ///< Odczyty pól przy liczeniu brzegu obszaru.
+} game_stats_t;
+
+/** @brief Podaje liczniki zdarzeń silnika gry.
+ * Liczniki są dostępne tylko wtedy, gdy plik game.c został skompilowany
+ * z makrem @p GAME_STATS (np. <tt>make STATS=1</tt>). W przeciwnym
+ * przypadku nie kosztują nic, a funkcja zeruje strukturę @p stats.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[out] stats  – wskaźnik na strukturę, do której są wpisywane liczniki.
+ * @return Wartość @p true, jeśli liczniki zostały wpisane, a @p false, gdy
+ * liczniki są wyłączone lub któryś ze wskaźników ma wartość NULL.
+ * @note Wątki: funkcja odczytująca.
+ */
+bool game_stats(game_t const *g, game_stats_t *stats);
+
 /** Podaje szerokość planszy.
  * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
  * @return Szerokość planszy lub zero, gdy wskaźnik @p g ma wartość NULL.
+ * @note Wątki: funkcja odczytująca.
  */
 uint32_t game_board_width(game_t const *g);
 
 /** Podaje wysokość planszy.
  * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
  * @return Wysokość planszy lub zero, gdy wskaźnik @p g ma wartość NULL.
+ * @note Wątki: funkcja odczytująca.
  */
 uint32_t game_board_height(game_t const *g);
 
@@ -91,12 +509,14 @@ uint32_t game_board_height(game_t const *g);
  *  na planszy.
  * @param g     - wskaźnik na strukturę przechowującą stan gry.
  * @return  Maksymalna liczba możliwych do zajęcia obaszarów.
+ * @note Wątki: funkcja odczytująca.
  */
 uint32_t game_areas(game_t const* g);
 
 /** Podaje liczbę graczy.
  * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
  * @return Liczba graczy lub zero, gdy wskaźnik @p g ma wartość NULL.
+ * @note Wątki: funkcja odczytująca.
  */
 uint32_t game_players(game_t const *g);
 
@@ -107,6 +527,7 @@ uint32_t game_players(game_t const *g);
  * @return Cyfra, litera lub inny jednoznakowy symbol gracza. Symbol oznaczający
  * puste pole, gdy numer gracza jest niepoprawny lub wskaźnik @p g ma wartość
  * NULL.
+ * @note Wątki: funkcja odczytująca.
  */
 char game_player(game_t const *g, uint32_t player);
 
@@ -118,21 +539,99 @@ char game_player(game_t const *g, uint32_t player);
  * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
  * @return Wskaźnik na alokowany bufor zawierający napis opisujący stan planszy
  * lub NULL, jeśli nie udało się alokować pamięci.
+ * @note Wątki: funkcja odczytująca.
  */
 char* game_board(game_t const *g);
 
+/**
+ * Funkcja wywoływana przez @ref game_board_rows dla kolejnych fragmentów
+ * wierszy planszy.
+ * @param[in] data    – wskaźnik przekazany do @ref game_board_rows,
+ * @param[in] y       – numer wiersza,
+ * @param[in] x       – numer kolumny pierwszego symbolu fragmentu,
+ * @param[in] symbols – symbole kolejnych pól fragmentu (bez znaku końca napisu),
+ * @param[in] length  – liczba symboli, nie większa od @ref GAME_BOARD_CHUNK.
+ * @return Wartość @p true, aby kontynuować, a @p false, aby przerwać
+ * przeglądanie planszy.
+ */
+typedef bool (*game_row_callback_t)(void *data, uint32_t y, uint32_t x,
+                                    char const *symbols, size_t length);
+
+/** Maksymalna liczba symboli przekazywanych w jednym wywołaniu
+ * funkcji @ref game_row_callback_t.
+ */
+#define GAME_BOARD_CHUNK 4096
+
+/** @brief Przegląda planszę wiersz po wierszu.
+ * Wywołuje funkcję @p callback dla kolejnych fragmentów wierszy, w tej
+ * samej kolejności, w jakiej pola są umieszczone w napisie zwracanym przez
+ * @ref game_board: od wiersza o największym numerze, a w wierszu od kolumny
+ * zero. Fragmenty są przekazywane w buforze o stałym rozmiarze, więc funkcja
+ * nie alokuje pamięci niezależnie od rozmiaru planszy.
+ * @param[in] g        – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] callback – funkcja wywoływana dla kolejnych fragmentów,
+ * @param[in] data     – wskaźnik przekazywany do funkcji @p callback.
+ * @return Wartość @p true, jeśli przejrzano całą planszę, a @p false, gdy
+ * funkcja @p callback przerwała przeglądanie lub któryś ze wskaźników
+ * ma wartość NULL.
+ * @note Wątki: funkcja odczytująca.
+ */
+bool game_board_rows(game_t const *g, game_row_callback_t callback, void *data);
+
+/** @brief Przegląda prostokątny fragment planszy wiersz po wierszu.
+ * Działa tak jak @ref game_board_rows, ale tylko dla pól (x, y), dla których
+ * @p x0 ≤ x < @p x0 + @p width i @p y0 ≤ y < @p y0 + @p height.
+ * @param[in] g        – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] x0       – numer pierwszej kolumny fragmentu,
+ * @param[in] y0       – numer pierwszego wiersza fragmentu,
+ * @param[in] width    – liczba kolumn fragmentu,
+ * @param[in] height   – liczba wierszy fragmentu,
+ * @param[in] callback – funkcja wywoływana dla kolejnych fragmentów wierszy,
+ * @param[in] data     – wskaźnik przekazywany do funkcji @p callback.
+ * @return Wartość @p true, jeśli przejrzano cały fragment, a @p false, gdy
+ * funkcja @p callback przerwała przeglądanie, fragment wychodzi poza planszę
+ * lub któryś ze wskaźników ma wartość NULL.
+ * @note Wątki: funkcja odczytująca.
+ */
+bool game_board_region(game_t const *g, uint32_t x0, uint32_t y0, uint32_t width,
+                       uint32_t height, game_row_callback_t callback, void *data);
+
+/** @brief Zapisuje opis stanu planszy do pliku.
+ * Zapisuje do pliku @p file ten sam napis, który zwraca funkcja
+ * @ref game_board, ale bez alokowania go w całości w pamięci.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in,out] file – plik, do którego jest zapisywany opis planszy.
+ * @return Wartość @p true, jeśli opis został zapisany, a @p false, gdy
+ * wystąpił błąd zapisu lub któryś ze wskaźników ma wartość NULL.
+ * @note Wątki: funkcja odczytująca.
+ */
+bool game_board_write(game_t const *g, FILE *file);
+
+/** @brief Sprawdza, czy gra się zakończyła.
+ * Gra kończy się, gdy żaden gracz nie może wykonać ruchu, czyli gdy
+ * @ref game_free_fields ma wartość zero dla każdego gracza. Gra przechowuje
+ * zbiór graczy, którzy mogą wykonać ruch, więc funkcja działa w czasie stałym.
+ * @param[in] g       – wskaźnik na strukturę przechowującą stan gry.
+ * @return Wartość @p true, jeśli żaden gracz nie może wykonać ruchu lub
+ * wskaźnik @p g ma wartość NULL, a @p false w przeciwnym przypadku.
+ * @note Wątki: funkcja odczytująca.
+ */
+bool game_is_over(game_t const *g);
+
 /** @brief Znajduje kolejnego "wolnego" gracza dla wykonania ruchu i jego numer
  *  wpisuje do current_player_number.
  * @param g                       - wskaźnik na strukturę przechowująca stan gry.
  * @param current_player_number   - wskaźnik na numer aktualnego gracza.
  * @return true jeśli udało się znaleźć kolejnego gracza oraz false w przeciwnym
- * przypadku
+ * przypadku. Działa w czasie stałym (zob. @ref game_is_over).
+ * @note Wątki: funkcja odczytująca.
  */
 bool find_next_player(game_t* g, uint32_t* current_player_number);
 
 /** @brief Wypisuje na standardowe wyjście ostateczną planszę gry wraz z
  * podsumowaniem, ile pól oraz obszarów zajął każdy z graczy.
  * @param g     - wskaźnik na strukturę przechowującą stan gry.
+ * @note Wątki: funkcja odczytująca.
  */
 void print_players_score(game_t* g);
 
@@ -0,0 +1,483 @@
+/** @file
+ * Benchmarks of the game engine.
+ *
+ * Every workload generates a seeded stream of moves, plays it and measures
+ * the number of operations per second and the latency percentiles of
+ * the engine functions used in the game loop: game_move, game_free_fields,
+ * find_next_player and game_board. Then game_move in a loop is compared
+ * with game_move_batch. At last game_move_concurrent is measured on a big
+ * board with 1, 2, 4, ... threads up to the number of processor cores, and
+ * at least with 4 threads.
+ * The results are written in the CSV format, so the results of different
+ * versions of the engine can be compared.
+ *
+ * Usage: ./game_bench [-o output_file] [seed]
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "game.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Default seed of all workloads.
+#define DEFAULT_SEED 2023
+
+// Number of times the batch measurement is repeated, the best one is reported.
+#define REPETITIONS 5
+
+// game_move_concurrent is measured at least with that many threads, also
+// on machines with fewer processor cores.
+#define MIN_CONCURRENT_THREADS 4
+
+// Maximum number of game_board calls in one workload.
+#define BOARD_CALLS 32
+
+// game_board is measured only on boards with at most that many fields.
+#define MAX_BOARD_FIELDS (16ULL << 20)
+
+/** @brief The kind of generated moves:
+ * UNIFORM         - random players on random fields,
+ * SNAKE           - one player filling the board column by column, going up
+ *                   and down, so all fields form one area.
+ */
+typedef enum Generator {
+    UNIFORM,
+    SNAKE
+} generator_t;
+
+/** @brief Parameters of one workload:
+ * name                     - the name printed in the report,
+ * width, height, players,
+ * areas                    - parameters of game_new,
+ * moves                    - the number of generated moves,
+ * generator                - the kind of generated moves.
+ */
+typedef struct Workload {
+    const char* name;
+    uint32_t width;
+    uint32_t height;
+    uint32_t players;
+    uint32_t areas;
+    size_t moves;
+    generator_t generator;
+} workload_t;
+
+// All workloads.
+static const workload_t WORKLOADS[] = {
+    {"small_dense", 64, 64, 4, 8, 1 << 20, UNIFORM},
+    {"huge_sparse", 100000, 100000, 8, 1000000, 1 << 13, UNIFORM},
+    {"single_area", 1024, 1024, 1, 1, 1 << 20, SNAKE},
+    {"many_areas", 2048, 2048, 2, 1000000000, 1 << 20, UNIFORM},
+    {"many_players", 256, 256, 61, 16, 1 << 20, UNIFORM},
+};
+
+// The workload of game_move_concurrent, the threads play its moves
+// in turns (the thread i of n plays the moves i, i + n, i + 2n, ...).
+static const workload_t CONCURRENT_WORKLOAD =
+    {"concurrent", 10000, 10000, 32, 1000000, 1 << 19, UNIFORM};
+
+/** @brief Latencies of one measured function:
+ * name            - the name of the function,
+ * latencies       - the latencies of all calls in nanoseconds,
+ * calls           - the number of calls,
+ * total           - the total time of all calls in nanoseconds.
+ */
+typedef struct Measurement {
+    const char* name;
+    uint64_t* latencies;
+    size_t calls;
+    uint64_t total;
+} measurement_t;
+
+// Returns the next pseudo random number from the state (xorshift64*).
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return *state * 2685821657736338717ULL;
+}
+
+// Returns the current time in nanoseconds.
+static uint64_t now(void) {
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (uint64_t)time.tv_sec * 1000000000ULL + (uint64_t)time.tv_nsec;
+}
+
+// Allocates the memory or exits the program with an error message.
+static void* allocate(size_t size) {
+    void* pointer = malloc(size);
+
+    if (!pointer) {
+        fprintf(stderr, "Cannot allocate memory.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    return pointer;
+}
+
+// Fills the array with moves of the given workload.
+static void generate_moves(workload_t const* w, move_t* moves, uint64_t seed) {
+    uint64_t state = seed | 1;
+
+    for (size_t i = 0; i < w->moves; i++) {
+        uint64_t value = next_random(&state);
+
+        if (w->generator == SNAKE) {
+            uint32_t column = (uint32_t)(i / w->height % w->width);
+            uint32_t row = (uint32_t)(i % w->height);
+
+            moves[i].player = 1;
+            moves[i].x = column;
+            moves[i].y = column % 2 == 0 ? row : w->height - 1 - row;
+        }
+        else {
+            moves[i].player = 1 + (uint32_t)(value % w->players);
+            moves[i].x = (uint32_t)((value >> 16) % w->width);
+            moves[i].y = (uint32_t)((value >> 40) % w->height);
+        }
+    }
+}
+
+// Prepares the measurement for at most capacity calls.
+static void start_measurement(measurement_t* m, const char* name, size_t capacity) {
+    m->name = name;
+    m->latencies = allocate((capacity > 0 ? capacity : 1) * sizeof(uint64_t));
+    m->calls = 0;
+    m->total = 0;
+}
+
+// Adds the latency of one call to the measurement.
+static void add_latency(measurement_t* m, uint64_t latency) {
+    m->latencies[m->calls++] = latency;
+    m->total += latency;
+}
+
+// Compares latencies for qsort.
+static int compare_latencies(const void* first, const void* second) {
+    uint64_t a = *(const uint64_t*)first;
+    uint64_t b = *(const uint64_t*)second;
+
+    return (a > b) - (a < b);
+}
+
+// Returns the latency below which the given fraction of calls is.
+static uint64_t percentile(measurement_t const* m, double fraction) {
+    size_t index = (size_t)(fraction * (double)m->calls);
+
+    return m->latencies[index < m->calls ? index : m->calls - 1];
+}
+
+// Prints one line of the report and frees the measurement.
+static void report(FILE* output, workload_t const* w, measurement_t* m) {
+    if (m->calls > 0) {
+        qsort(m->latencies, m->calls, sizeof(uint64_t), compare_latencies);
+        fprintf(output, "%s,%ux%u,%u,%s,%zu,%.0f,%lu,%lu,%lu\n", w->name, w->width,
+                w->height, w->players, m->name, m->calls,
+                m->total > 0 ? (double)m->calls * 1e9 / (double)m->total : 0.0,
+                percentile(m, 0.5), percentile(m, 0.99), percentile(m, 0.999));
+    }
+
+    free(m->latencies);
+}
+
+// The results of the measured reading calls are added here, so
+// the compiler cannot drop the calls.
+static volatile uint64_t sink;
+
+// Plays the moves of the workload measuring every engine call.
+static void bench_latencies(FILE* output, workload_t const* w, move_t const* moves) {
+    game_t* g = game_new(w->width, w->height, w->players, w->areas);
+    measurement_t move, free_fields, next_player, board;
+    uint32_t current_player = 1;
+    uint64_t start;
+
+    if (!g) {
+        fprintf(stderr, "Cannot create the game %s.\n", w->name);
+        exit(EXIT_FAILURE);
+    }
+
+    start_measurement(&move, "game_move", w->moves);
+    start_measurement(&free_fields, "game_free_fields", w->moves);
+    start_measurement(&next_player, "find_next_player", w->moves);
+    start_measurement(&board, "game_board", BOARD_CALLS);
+
+    for (size_t i = 0; i < w->moves; i++) {
+        start = now();
+        bool done = game_move(g, moves[i].player, moves[i].x, moves[i].y);
+        add_latency(&move, now() - start);
+
+        start = now();
+        uint64_t fields = game_free_fields(g, moves[i].player);
+        add_latency(&free_fields, now() - start);
+        sink += fields;
+
+        if (done) {
+            start = now();
+            find_next_player(g, &current_player);
+            add_latency(&next_player, now() - start);
+        }
+    }
+
+    if ((uint64_t)w->width * w->height <= MAX_BOARD_FIELDS) {
+        for (int i = 0; i < BOARD_CALLS; i++) {
+            start = now();
+            char* text = game_board(g);
+            add_latency(&board, now() - start);
+            free(text);
+        }
+    }
+
+    report(output, w, &move);
+    report(output, w, &free_fields);
+    report(output, w, &next_player);
+    report(output, w, &board);
+    game_delete(g);
+}
+
+// Plays all moves with game_move or game_move_batch, returns the time in
+// nanoseconds.
+static uint64_t play(workload_t const* w, move_t const* moves, uint8_t* results, bool batch) {
+    game_t* g = game_new(w->width, w->height, w->players, w->areas);
+    uint64_t start = now();
+
+    if (batch) {
+        game_move_batch(g, moves, w->moves, results);
+    }
+    else {
+        for (size_t i = 0; i < w->moves; i++) {
+            results[i] = game_move(g, moves[i].player, moves[i].x, moves[i].y);
+        }
+    }
+
+    uint64_t time = now() - start;
+
+    game_delete(g);
+
+    return time;
+}
+
+// Compares game_move in a loop with game_move_batch on one workload.
+// Returns false if they gave different results.
+static bool bench_batch(FILE* output, workload_t const* w, move_t const* moves) {
+    uint8_t* loop_results = allocate(w->moves);
+    uint8_t* batch_results = allocate(w->moves);
+    uint64_t loop_time = UINT64_MAX;
+    uint64_t batch_time = UINT64_MAX;
+    bool correct = true;
+
+    for (int i = 0; i < REPETITIONS; i++) {
+        uint64_t time = play(w, moves, loop_results, false);
+        loop_time = time < loop_time ? time : loop_time;
+        time = play(w, moves, batch_results, true);
+        batch_time = time < batch_time ? time : batch_time;
+
+        if (memcmp(loop_results, batch_results, w->moves) != 0) {
+            correct = false;
+        }
+    }
+
+    // Latencies of single moves are not measured here.
+    fprintf(output, "%s,%ux%u,%u,game_move_loop,%zu,%.0f,,,\n", w->name, w->width,
+            w->height, w->players, w->moves, (double)w->moves * 1e9 / (double)loop_time);
+    fprintf(output, "%s,%ux%u,%u,game_move_batch,%zu,%.0f,,,\n", w->name, w->width,
+            w->height, w->players, w->moves, (double)w->moves * 1e9 / (double)batch_time);
+
+    if (!correct) {
+        fprintf(stderr, "game_move_batch differs from game_move in %s.\n", w->name);
+    }
+
+    free(loop_results);
+    free(batch_results);
+
+    return correct;
+}
+
+/** @brief One thread of the concurrent measurement:
+ * g               - the game in the concurrent mode,
+ * moves, length   - the moves of the workload,
+ * first, step     - the thread plays the moves first, first + step, ...,
+ * results         - the results of all moves, the thread writes only
+ *                   the results of its moves,
+ * thread          - the thread.
+ */
+typedef struct Mover {
+    game_t* g;
+    move_t const* moves;
+    size_t length;
+    size_t first;
+    size_t step;
+    uint8_t* results;
+    pthread_t thread;
+} mover_t;
+
+static void* play_concurrent(void* data) {
+    mover_t* mover = data;
+
+    for (size_t i = mover->first; i < mover->length; i += mover->step) {
+        move_t const* move = &mover->moves[i];
+
+        mover->results[i] = game_move_concurrent(mover->g, move->player, move->x, move->y);
+    }
+
+    return NULL;
+}
+
+// Plays all moves with game_move_concurrent in the given number of threads.
+// Returns the time in nanoseconds, writes the results of the moves and
+// the hash of the board after them.
+static uint64_t play_threads(workload_t const* w, move_t const* moves, size_t threads,
+                             uint8_t* results, uint64_t* hash) {
+    game_t* g = game_new(w->width, w->height, w->players, w->areas);
+    mover_t* movers = allocate(threads * sizeof(mover_t));
+
+    if (!g || !game_set_concurrent(g, true)) {
+        fprintf(stderr, "Cannot create the game %s.\n", w->name);
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t start = now();
+
+    for (size_t i = 0; i < threads; i++) {
+        movers[i] = (mover_t){g, moves, w->moves, i, threads, results, 0};
+
+        if (pthread_create(&movers[i].thread, NULL, play_concurrent, &movers[i]) != 0) {
+            fprintf(stderr, "Cannot create a thread.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (size_t i = 0; i < threads; i++) {
+        pthread_join(movers[i].thread, NULL);
+    }
+
+    uint64_t time = now() - start;
+
+    game_set_concurrent(g, false);
+    *hash = game_hash(g);
+    game_delete(g);
+    free(movers);
+
+    return time;
+}
+
+// Measures game_move_concurrent with 1, 2, 4, ... threads up to the number
+// of processor cores, at least up to MIN_CONCURRENT_THREADS. Returns false if the moves played by one thread gave
+// different results or a different board than game_move_batch.
+static bool bench_concurrent(FILE* output, workload_t const* w, move_t const* moves) {
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+    game_t* g = game_new(w->width, w->height, w->players, w->areas);
+    uint8_t* expected = allocate(w->moves);
+    uint8_t* results = allocate(w->moves);
+    bool correct = true;
+
+    if (!g) {
+        fprintf(stderr, "Cannot create the game %s.\n", w->name);
+        exit(EXIT_FAILURE);
+    }
+
+    game_move_batch(g, moves, w->moves, expected);
+
+    uint64_t expected_hash = game_hash(g);
+
+    game_delete(g);
+
+    for (size_t threads = 1; threads <= MIN_CONCURRENT_THREADS || threads <= (size_t)cores; threads *= 2) {
+        uint64_t best = UINT64_MAX;
+        uint64_t hash;
+
+        for (int i = 0; i < REPETITIONS; i++) {
+            uint64_t time = play_threads(w, moves, threads, results, &hash);
+            best = time < best ? time : best;
+
+            // The order of moves of many threads is not fixed.
+            if (threads == 1 &&
+                (memcmp(results, expected, w->moves) != 0 || hash != expected_hash)) {
+                correct = false;
+            }
+        }
+
+        fprintf(output, "%s,%ux%u,%u,game_move_concurrent_%zu,%zu,%.0f,,,\n", w->name,
+                w->width, w->height, w->players, threads, w->moves,
+                (double)w->moves * 1e9 / (double)best);
+    }
+
+    if (cores < MIN_CONCURRENT_THREADS) {
+        fprintf(stderr, "Only %ld processor cores, the rows of game_move_concurrent with "
+                        "more threads show the cost of locks, not the scaling.\n", cores);
+    }
+    if (!correct) {
+        fprintf(stderr, "game_move_concurrent differs from game_move in %s.\n", w->name);
+    }
+
+    free(expected);
+    free(results);
+
+    return correct;
+}
+
+int main(const int argc, const char* argv[]) {
+    uint64_t seed = DEFAULT_SEED;
+    FILE* output = stdout;
+    int argument = 1;
+
+    if (argc > 2 && strcmp(argv[1], "-o") == 0) {
+        output = fopen(argv[2], "w");
+
+        if (!output) {
+            fprintf(stderr, "Cannot open %s.\n", argv[2]);
+            return 1;
+        }
+
+        argument = 3;
+    }
+    if (argc > argument + 1) {
+        fprintf(stderr, "Usage: %s [-o output_file] [seed]\n", argv[0]);
+        return 1;
+    }
+    if (argc == argument + 1) {
+        char* end_string;
+
+        seed = strtoull(argv[argument], &end_string, 10);
+
+        if (*argv[argument] == '\0' || *end_string != '\0') {
+            fprintf(stderr, "Invalid seed value: %s\n", argv[argument]);
+            return 1;
+        }
+    }
+
+    bool correct = true;
+
+    fprintf(output, "workload,board,players,operation,calls,ops_per_s,"
+                    "p50_ns,p99_ns,p999_ns\n");
+
+    for (size_t i = 0; i < sizeof(WORKLOADS) / sizeof(WORKLOADS[0]); i++) {
+        workload_t const* w = &WORKLOADS[i];
+        move_t* moves = allocate(w->moves * sizeof(move_t));
+
+        generate_moves(w, moves, seed + i);
+        bench_latencies(output, w, moves);
+        correct &= bench_batch(output, w, moves);
+        fflush(output);
+        free(moves);
+    }
+
+    move_t* moves = allocate(CONCURRENT_WORKLOAD.moves * sizeof(move_t));
+
+    generate_moves(&CONCURRENT_WORKLOAD, moves, seed + sizeof(WORKLOADS) / sizeof(WORKLOADS[0]));
+    correct &= bench_concurrent(output, &CONCURRENT_WORKLOAD, moves);
+    free(moves);
+
+    if (output != stdout) {
+        fclose(output);
+    }
+
+    return correct ? 0 : 1;
+}
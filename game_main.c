@@ -1,5 +1,11 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include "game.h"
+#include "monte_carlo.h"
+#include <errno.h>
 #include <ncurses.h>
+#include <string.h>
+#include <time.h>
 
 // This constant describes the ^D command.
 #define GAME_BREAK 4
@@ -46,6 +52,30 @@
 // The column of the upper left corner of the board.
 #define FIRST_COLUMN 0
 
+// The number of screen lines of the status panel under the board.
+#define STATUS_LINES 6
+
+// The minimal time between two frames in milliseconds (about 60 frames
+// per second).
+#define FRAME_INTERVAL 16
+
+// The option starting the headless replay mode.
+#define REPLAY_OPTION "--replay"
+
+// The size of the buffer used for reading the move log.
+#define REPLAY_BUFFER_SIZE (1 << 20)
+
+// The number of moves passed to game_move_batch at once.
+#define REPLAY_BATCH_MOVES 4096
+
+// The option making a player computer-controlled.
+#define BOT_OPTION "--bot"
+
+// The time of thinking of a computer player over one move in milliseconds,
+// when it is not given after the player number, and its maximum.
+#define DEFAULT_BOT_MILLISECONDS 1000
+#define MAX_BOT_MILLISECONDS 3600000
+
 static void start_TUI_mode() {
 
     // Turn on the TUI mode.
@@ -86,7 +116,10 @@ static void check_game_parameters(const int argc, const char **argv, uint32_t* w
 
     // Check if the number of input arguments is correct.
     if (argc != 5) {
-        fprintf(stderr, "Usage: %s <width> <height> <players> <areas>\n", argv[0]);
+        fprintf(stderr, "Usage: %s <width> <height> <players> <areas> "
+                        "[%s <player>[:<milliseconds>]]...\n"
+                        "       %s %s <width> <height> <players> <areas> [move_log]\n",
+                argv[0], BOT_OPTION, argv[0], REPLAY_OPTION);
         exit(EXIT_FAILURE);
     }
 
@@ -125,198 +158,692 @@ static void check_game_parameters(const int argc, const char **argv, uint32_t* w
     *areas = (uint32_t)converted_value;
 }
 
-// Checks the size of the game board and if it is bigger
-// than size of user monitor returns false. Returns true otherwise.
-static bool check_screen(const uint32_t width, const uint32_t height) {
-    if (width > (uint32_t)(SCREEN_WIDTH - 1) || height > (uint32_t)(SCREEN_HEIGHT - 1)) {
-        end_TUI_mode();
-        fprintf(stderr, "Invalid game board size.\n");
+/** @brief Reads the options "--bot player[:milliseconds]" following the game
+ * parameters. Exits the program with an error message if some option is
+ * not valid.
+ * @param argc      - the number of the options,
+ * @param argv      - the options,
+ * @param players   - the number of players,
+ * @param bots      - the array of the times of thinking of all players,
+ *                    zero for a player controlled by the user.
+ */
+static void check_bot_options(const int argc, const char **argv, const uint32_t players,
+                              uint64_t* bots) {
+    for (int i = 0; i < argc; i += 2) {
+        if (strcmp(argv[i], BOT_OPTION) != 0 || i + 1 == argc) {
+            fprintf(stderr, "Invalid option: %s\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+
+        char* end_string;
+        uint64_t player = strtoul(argv[i + 1], &end_string, 10);
+        uint64_t time = DEFAULT_BOT_MILLISECONDS;
 
-        return false;
+        if (*end_string == ':') {
+            time = strtoul(end_string + 1, &end_string, 10);
+        }
+
+        if (*end_string != '\0' || player == 0 || player > players || time == 0 ||
+            time > MAX_BOT_MILLISECONDS) {
+            fprintf(stderr, "Invalid bot value: %s\n", argv[i + 1]);
+            exit(EXIT_FAILURE);
+        }
+
+        bots[player - 1] = time;
     }
-    else if (height > (uint32_t)(SCREEN_HEIGHT - 7)) {
-        printw("The game board is to big for that screen and some information about the game"
-               " status may not be displayed.\n"
-               "To continue press any button.");
-        refresh();
+}
 
-        // Waits on user bottom for continue the game_in_TUI_mode.
-        getch();
+/** @brief The part of the game board shown on the screen:
+ * top             - the screen row (counted from the top row of the board)
+ *                   of the first shown row,
+ * left            - the first shown column,
+ * rows            - the number of shown rows,
+ * columns         - the number of shown columns.
+ */
+typedef struct Viewport {
+    uint32_t top;
+    uint32_t left;
+    uint32_t rows;
+    uint32_t columns;
+} viewport_t;
+
+/** @brief The state of draw_row:
+ * view            - the drawn viewport,
+ * height          - the height of the game board.
+ */
+typedef struct Row_painter {
+    viewport_t const* view;
+    uint32_t height;
+} row_painter_t;
+
+// Fits the size of the viewport to the size of the screen, leaving
+// STATUS_LINES lines for the status panel.
+static void fit_viewport(viewport_t* view, const uint32_t width, const uint32_t height) {
+    uint32_t screen_rows = SCREEN_HEIGHT > STATUS_LINES ? (uint32_t)(SCREEN_HEIGHT - STATUS_LINES) : 1;
+    uint32_t screen_columns = SCREEN_WIDTH > 0 ? (uint32_t)SCREEN_WIDTH : 1;
+
+    view->rows = height < screen_rows ? height : screen_rows;
+    view->columns = width < screen_columns ? width : screen_columns;
+
+    if (view->top > height - view->rows) {
+        view->top = height - view->rows;
+    }
+    if (view->left > width - view->columns) {
+        view->left = width - view->columns;
+    }
+}
 
-        // Clear the previous message.
-        clear();
+// Returns the first shown position which keeps the cursor on the screen,
+// the cursor is moved to the middle of the screen when it leaves it.
+static uint32_t follow(const uint32_t first, const uint32_t shown, const uint32_t all,
+                       const uint32_t cursor) {
+    if (cursor >= first && cursor - first < shown) {
+        return first;
     }
 
+    uint32_t centered = cursor > shown / 2 ? cursor - shown / 2 : 0;
+
+    return centered > all - shown ? all - shown : centered;
+}
+
+// Draws one fragment of a row of the board, see game_board_region.
+static bool draw_row(void* data, uint32_t y, uint32_t x, char const* symbols, size_t length) {
+    row_painter_t const* painter = data;
+
+    mvaddnstr((int)(painter->height - 1 - y - painter->view->top),
+              (int)(x - painter->view->left), symbols, (int)length);
+
     return true;
 }
 
-// Prints in TUI the empty game board.
-static void print_empty_board(const uint32_t width, const uint32_t height) {
-    for (uint32_t i = FIRST_ROW; i < height; i++) {
-        for (uint32_t j = FIRST_COLUMN; j < width; j++) {
-            mvprintw(i, j, ".");
-        }
-    }
+// Draws the whole viewport of the game board.
+static void draw_viewport(game_t const* g, viewport_t const* view) {
+    uint32_t height = game_board_height(g);
+    row_painter_t painter = {view, height};
+
+    erase();
+    game_board_region(g, view->left, height - view->top - view->rows, view->columns,
+                      view->rows, draw_row, &painter);
 }
 
-static void go_left(const uint32_t* current_row, uint32_t* current_column) {
+static void go_left(uint32_t* current_column) {
     if (*current_column == FIRST_COLUMN) {
         return;
     }
 
     (*current_column)--;
-    move(*current_row, *current_column);
-    refresh();
 }
 
-static void go_right(const uint32_t width, const uint32_t* current_row,
-              uint32_t* current_column) {
+static void go_right(const uint32_t width, uint32_t* current_column) {
     if (*current_column == width - 1) {
         return;
     }
 
     (*current_column)++;
-    move(*current_row, *current_column);
-    refresh();
 }
 
-static void go_up(uint32_t* current_row, const uint32_t* current_column) {
+static void go_up(uint32_t* current_row) {
     if (*current_row == FIRST_ROW) {
         return;
     }
 
     (*current_row)--;
-    move(*current_row, *current_column);
-    refresh();
 }
 
-static void go_down(uint32_t height, uint32_t* current_row,
-             const uint32_t* current_column) {
+static void go_down(uint32_t height, uint32_t* current_row) {
     if (*current_row == height - 1) {
         return;
     }
 
     (*current_row)++;
-    move(*current_row, *current_column);
-    refresh();
 }
 
-/** @brief Write a board state for a current player.
- * @param g                         - pointer on a game_in_TUI_mode structure,
- * @param current_player_number     - nonnegative number of current player,
+/** @brief The values shown in the status panel:
+ * player          - the number of the current player,
+ * free_fields     - the number of fields the current player can take,
+ * busy_fields     - the number of fields taken by the current player,
+ * general_free    - the number of free fields on the board,
+ * thinking        - true if the current player is a computer looking for
+ *                   his move,
+ * playouts        - the number of random games played by him per second.
+ */
+typedef struct Status {
+    uint32_t player;
+    uint64_t free_fields;
+    uint64_t busy_fields;
+    uint64_t general_free;
+    bool thinking;
+    uint64_t playouts;
+} status_t;
+
+/** @brief The state of the interactive mode:
+ * g               - pointer on the game structure,
+ * width, height   - the size of the game board,
+ * current_row     - the cursor row counted from the top row of the board,
+ * current_column  - the cursor column,
+ * current_player_number - the number of the current player,
+ * lets_play       - true if there exists players which could put figures
+ *                   on the board,
+ * view            - the shown part of the game board,
+ * shown           - the values shown in the status panel,
+ * shown_valid     - false if the status panel has to be drawn again,
+ * bots            - the times of thinking of all players over one move
+ *                   in milliseconds, zero for a player controlled by the user,
+ * search          - the search of the moves of computer players or NULL
+ *                   if there is none,
+ * thinking        - true if the search for the current player is running,
+ * thinking_since  - the beginning of that search (see milliseconds).
+ * The search runs in other threads, so the user can move the cursor while
+ * a computer player is thinking.
  */
-static void board_state(game_t const* g, uint32_t current_player_number) {
-    mvprintw(game_board_height(g), FIRST_COLUMN, "Current player: %lu. \n"
+typedef struct Tui {
+    game_t* g;
+    uint32_t width;
+    uint32_t height;
+    uint32_t current_row;
+    uint32_t current_column;
+    uint32_t current_player_number;
+    bool lets_play;
+    viewport_t view;
+    status_t shown;
+    bool shown_valid;
+    uint64_t const* bots;
+    monte_carlo_t* search;
+    bool thinking;
+    int64_t thinking_since;
+} tui_t;
+
+// Returns the number of milliseconds from some fixed point in the past.
+static int64_t milliseconds(void) {
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (int64_t)time.tv_sec * 1000 + time.tv_nsec / 1000000;
+}
+
+/** @brief Write a board state for a current player under the viewport.
+ * Nothing is written if the shown values did not change.
+ * @param t         - the state of the interactive mode.
+ */
+static void board_state(tui_t* t) {
+    status_t status = {t->current_player_number,
+                       game_free_fields(t->g, t->current_player_number),
+                       game_busy_fields(t->g, t->current_player_number),
+                       game_general_free_fields(t->g), t->thinking, 0};
+
+    if (t->thinking) {
+        int64_t elapsed = milliseconds() - t->thinking_since;
+
+        status.playouts = monte_carlo_playouts(t->search) * 1000 /
+                          (uint64_t)(elapsed > 0 ? elapsed : 1);
+    }
+
+    if (t->shown_valid && status.player == t->shown.player &&
+        status.free_fields == t->shown.free_fields &&
+        status.busy_fields == t->shown.busy_fields &&
+        status.general_free == t->shown.general_free &&
+        status.thinking == t->shown.thinking && status.playouts == t->shown.playouts) {
+        return;
+    }
+
+    t->shown = status;
+    t->shown_valid = true;
+    move((int)t->view.rows, FIRST_COLUMN);
+    clrtobot();
+    mvprintw((int)t->view.rows, FIRST_COLUMN, "Current player: %u. \n"
                                    "Number of free fields: %lu. \n"
                                    "Number of occupied fields bu current player: %lu. \n"
                                    "Number of free fields on the game board: %lu. \n"
-                                   "To make a move choose a free field on the game board and press SPACE. \n"
-                                   "To resign from making a move press C and press CTRL + D to end the game.",
-                                        current_player_number,
-                                        game_free_fields(g, current_player_number),
-                                        game_busy_fields(g, current_player_number),
-                                        game_general_free_fields(g));
+                                   "%s",
+                                        status.player, status.free_fields,
+                                        status.busy_fields, status.general_free,
+                                        status.thinking ? "" :
+                                        "To make a move choose a free field on the game board and press SPACE. \n"
+                                        "To resign from making a move press C and press CTRL + D to end the game.");
+
+    if (status.thinking) {
+        mvprintw((int)t->view.rows + 4, FIRST_COLUMN,
+                 "Computer player %u is thinking: %lu playouts per second. \n"
+                 "Press CTRL + D to end the game.", status.player, status.playouts);
+    }
+}
+
+// Draws the whole screen again, after the viewport was moved or resized.
+static void redraw(tui_t* t) {
+    draw_viewport(t->g, &t->view);
+    t->shown_valid = false;
+}
+
+/** @brief Draws one frame: moves the viewport after the cursor, redraws it
+ * if it was moved, updates the status panel and puts the cursor on the screen.
+ * @param t         - the state of the interactive mode.
+ */
+static void draw_frame(tui_t* t) {
+    uint32_t top = follow(t->view.top, t->view.rows, t->height, t->current_row);
+    uint32_t left = follow(t->view.left, t->view.columns, t->width, t->current_column);
+
+    if (top != t->view.top || left != t->view.left) {
+        t->view.top = top;
+        t->view.left = left;
+        redraw(t);
+    }
+
+    board_state(t);
+    move((int)(t->current_row - t->view.top), (int)(t->current_column - t->view.left));
+    refresh();
+}
+
+// Makes the move of the current player on the field (x,y) and passes
+// the turn to the next player. Returns false if the move is not legal.
+static bool play_move(tui_t* t, uint32_t x, uint32_t y) {
+    if (!game_move(t->g, t->current_player_number, x, y)) {
+        return false;
+    }
+
+    uint32_t row = t->height - 1 - y;
+
+    // Only the taken field changed on the board. If it is not
+    // shown, the viewport is moved and drawn in the next frame.
+    if (row - t->view.top < t->view.rows && x - t->view.left < t->view.columns) {
+        mvaddch((int)(row - t->view.top), (int)(x - t->view.left),
+                (chtype)(unsigned char)game_player(t->g, t->current_player_number));
+    }
+
+    find_next_player(t->g, &t->current_player_number);
+
+    if (game_is_over(t->g)) {
+        t->lets_play = false;
+    }
+
+    return true;
+}
+
+// Deals with one key pressed by the user. Changes only the state and
+// the ncurses buffer, the screen is updated by draw_frame.
+static void handle_key(tui_t* t, int user_input) {
+    switch (user_input) {
+        case MOVE_SHIFT_LEFT:
+        case MOVE_LEFT:
+            go_left(&t->current_column);
+            break;
+
+        case MOVE_SHIFT_RIGHT:
+        case MOVE_RIGHT:
+            go_right(t->width, &t->current_column);
+            break;
+
+        case MOVE_SHIFT_UP:
+        case MOVE_UP:
+            go_up(&t->current_row);
+            break;
+
+        case MOVE_SHIFT_DOWN:
+        case MOVE_DOWN:
+            go_down(t->height, &t->current_row);
+            break;
+
+        // A computer player makes his own moves.
+        case SPACE:
+            if (!t->thinking) {
+                play_move(t, t->current_column, t->height - 1 - t->current_row);
+            }
+
+            break;
+
+        case 'c':
+        case 'C':
+            if (!t->thinking) {
+                find_next_player(t->g, &t->current_player_number);
+            }
+
+            break;
+
+        case KEY_RESIZE:
+            fit_viewport(&t->view, t->width, t->height);
+            redraw(t);
+            break;
+
+        default:
+            break;
+    }
+}
+
+/** @brief Lets the computer players move. Makes the move found by the search
+ * when its time is over and starts the search when a computer player gets
+ * the turn. A computer player without a move passes it.
+ * @param t         - the state of the interactive mode.
+ */
+static void update_bots(tui_t* t) {
+    move_t move;
+
+    if (t->thinking && monte_carlo_done(t->search)) {
+        t->thinking = false;
+
+        if (monte_carlo_finish(t->search, false, &move) && !play_move(t, move.x, move.y)) {
+            find_next_player(t->g, &t->current_player_number);
+        }
+    }
+
+    if (t->lets_play && !t->thinking && t->bots[t->current_player_number - 1] > 0) {
+        if (monte_carlo_start(t->search, t->g, t->current_player_number,
+                              t->bots[t->current_player_number - 1])) {
+            t->thinking = true;
+            t->thinking_since = milliseconds();
+        }
+        else {
+            find_next_player(t->g, &t->current_player_number);
+
+            if (game_is_over(t->g)) {
+                t->lets_play = false;
+            }
+        }
+    }
+}
+
+/** @brief Deals with all keys pressed before the next frame. Reads the keys
+ * which are already waiting and, if the last frame was drawn less than
+ * FRAME_INTERVAL milliseconds ago, also the keys pressed until then, so
+ * holding a key down draws at most one frame per FRAME_INTERVAL.
+ * @param t            - the state of the interactive mode,
+ * @param next_frame   - the time (see milliseconds) of the next frame.
+ * @return false if the user ended the game and true otherwise.
+ */
+static bool drain_input(tui_t* t, int64_t next_frame) {
+    bool playing = true;
+
+    while (playing && t->lets_play) {
+        int64_t remaining = next_frame - milliseconds();
+
+        timeout(remaining > 0 ? (int)remaining : 0);
+
+        int user_input = getch();
+
+        if (user_input == GAME_BREAK) {
+            playing = false;
+        }
+        else if (user_input != ERR) {
+            handle_key(t, user_input);
+        }
+        else if (remaining <= 0 || milliseconds() >= next_frame) {
+            break;
+        }
+    }
+
+    // Wait for the next key without a limit.
+    timeout(-1);
+
+    return playing;
 }
 
 /** Deal with the interactive game mode, prints the game board state, players
  * information, at the end of the procedure deletes all malloced data.
- * @param g  - pointer on the game structure.
+ * Only the part of the board around the cursor is shown, so the board
+ * may be bigger than the screen. All keys pressed before the next frame
+ * are handled together and the screen is updated once for them.
+ * While a computer player is thinking, a frame is drawn every
+ * FRAME_INTERVAL milliseconds also without keys pressed.
+ * @param g       - pointer on the game structure,
+ * @param bots    - the times of thinking of all players (see tui_t),
+ * @param search  - the search used by computer players or NULL.
  */
-static void game_in_TUI_mode(game_t* g) {
-    uint32_t width, height;
-    int user_input;
-    char* result_board;
+static void game_in_TUI_mode(game_t* g, uint64_t const* bots, monte_carlo_t* search) {
+    // The cursor starts in the left upper corner.
+    tui_t t = {g, game_board_width(g), game_board_height(g), FIRST_ROW, FIRST_COLUMN,
+               1, true, {0, 0, 0, 0}, {0, 0, 0, 0, false, 0}, false, bots, search,
+               false, 0};
 
-    width = game_board_width(g);
-    height = game_board_height(g);
+    fit_viewport(&t.view, t.width, t.height);
+    redraw(&t);
+    update_bots(&t);
+    draw_frame(&t);
 
-    // Define two local variables to keep the curent cursor localization.
-    uint32_t current_row = FIRST_ROW;
-    uint32_t current_column = FIRST_COLUMN;
+    int64_t next_frame = milliseconds() + FRAME_INTERVAL;
 
-    uint32_t current_player_number = 1;
-    bool move_completed = false; // Keeps the result of game_move function.
+    while (t.lets_play) {
+        timeout(t.thinking ? FRAME_INTERVAL : -1);
 
-    // This variable keeps the game status i.e.
-    // is true if there exists players which could
-    // put figures on the board.
-    bool lets_play = true;
+        int user_input = getch();
+        bool playing = user_input != GAME_BREAK;
 
-    // Move the cursor on the left upper corner.
-    board_state(g, current_player_number);
-    move(current_row, current_column);
-    refresh();
+        if (playing && user_input != ERR) {
+            handle_key(&t, user_input);
+            playing = drain_input(&t, next_frame);
+        }
 
-    while (((user_input = getch()) != GAME_BREAK) && (lets_play == true)) {
-        switch (user_input) {
-            case MOVE_SHIFT_LEFT:
-            case MOVE_LEFT:
-                go_left(&current_row, &current_column);
-                break;
-
-            case MOVE_SHIFT_RIGHT:
-            case MOVE_RIGHT:
-                go_right(width, &current_row, &current_column);
-                break;
-
-            case MOVE_SHIFT_UP:
-            case MOVE_UP:
-                go_up(&current_row, &current_column);
-                break;
-
-            case MOVE_SHIFT_DOWN:
-            case MOVE_DOWN:
-                go_down(height, &current_row, &current_column);
-                break;
-
-            case SPACE:
-                move_completed = game_move(g, current_player_number, current_column,
-                                           height - 1 - (uint32_t)current_row);
-
-                if (move_completed) {
-                    mvprintw(current_row, current_column, "%c", game_player(g, current_player_number));
-
-                    if (!find_next_player(g, &current_player_number)) {
-                        lets_play = false;
-                    }
-
-                    board_state(g, current_player_number);
-                    move(current_row, current_column);
-                    refresh();
-                }
-
-                break;
-
-            case 'c':
-            case 'C':
-                find_next_player(g, &current_player_number);
-                board_state(g, current_player_number);
-                move(current_row, current_column);
-                refresh();
-                break;
-
-            default:
-                break;
+        if (!playing) {
+            break;
         }
+
+        update_bots(&t);
+        draw_frame(&t);
+        next_frame = milliseconds() + FRAME_INTERVAL;
+    }
+
+    move_t move;
+
+    if (t.thinking) {
+        monte_carlo_finish(search, true, &move);
     }
 
     end_TUI_mode();
 
     // Print the game board and the player scores.
-    result_board = game_board(g);
-    printf("%s", result_board);
+    game_board_write(g, stdout);
     print_players_score(g);
 
-    // Free all malloc data.
-    free(result_board);
     game_delete(g);
 }
 
+/** @brief The state of reading the move log:
+ * file            - the read file,
+ * buffer          - the last read part of the file,
+ * length          - the number of valid characters in the buffer,
+ * position        - the position of the next character in the buffer,
+ * line            - the number of the current line (for error messages).
+ */
+typedef struct Replay_reader {
+    FILE* file;
+    char* buffer;
+    size_t length;
+    size_t position;
+    uint64_t line;
+} replay_reader_t;
+
+// Returns the next character of the move log or EOF at its end.
+static int next_char(replay_reader_t* reader) {
+    if (reader->position == reader->length) {
+        reader->length = fread(reader->buffer, 1, REPLAY_BUFFER_SIZE, reader->file);
+        reader->position = 0;
+
+        if (reader->length == 0) {
+            return EOF;
+        }
+    }
+
+    return (unsigned char)reader->buffer[reader->position++];
+}
+
+/** @brief Reads the next number of the move log.
+ * @param reader    - pointer on the state of reading,
+ * @param value     - pointer on the place for the read number.
+ * @return 1 if the number was read, 0 at the end of the log and -1
+ * if the log is not valid.
+ */
+static int read_log_number(replay_reader_t* reader, uint32_t* value) {
+    int c = next_char(reader);
+
+    while (c == ' ' || c == '\t' || c == '\r' || c == '\n') {
+        if (c == '\n') {
+            reader->line++;
+        }
+
+        c = next_char(reader);
+    }
+
+    if (c == EOF) {
+        return 0;
+    }
+    if (c < '0' || c > '9') {
+        return -1;
+    }
+
+    uint64_t number = 0;
+
+    while (c >= '0' && c <= '9') {
+        number = number * 10 + (uint64_t)(c - '0');
+
+        if (number > UINT32_MAX) {
+            return -1;
+        }
+
+        c = next_char(reader);
+    }
+
+    // Give back the separator, so the lines are counted correctly.
+    if (c != EOF) {
+        reader->position--;
+    }
+
+    *value = (uint32_t)number;
+
+    return 1;
+}
+
+/** @brief Reads moves "player x y" from the file and makes them without
+ * the TUI, then prints the game board and the player scores. Some statistics
+ * of the replay are printed on the standard error output.
+ * @param g         - pointer on the game structure,
+ * @param file      - the move log.
+ * @return true if the whole log was read and false if it is not valid.
+ */
+static bool replay(game_t* g, FILE* file) {
+    replay_reader_t reader = {file, malloc(REPLAY_BUFFER_SIZE), 0, 0, 1};
+    move_t* moves = malloc(REPLAY_BATCH_MOVES * sizeof(move_t));
+    uint64_t all_moves = 0;
+    uint64_t accepted_moves = 0;
+    size_t length = 0;
+    bool valid = true;
+    struct timespec start, end;
+
+    if (!reader.buffer || !moves) {
+        free(reader.buffer);
+        free(moves);
+        fprintf(stderr, "Cannot allocate memory.\n");
+
+        return false;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    while (valid) {
+        int result = read_log_number(&reader, &moves[length].player);
+
+        if (result == 0) {
+            break;
+        }
+
+        valid = result == 1 &&
+                read_log_number(&reader, &moves[length].x) == 1 &&
+                read_log_number(&reader, &moves[length].y) == 1;
+
+        if (valid && ++length == REPLAY_BATCH_MOVES) {
+            accepted_moves += game_move_batch(g, moves, length, NULL);
+            all_moves += length;
+            length = 0;
+        }
+    }
+
+    accepted_moves += game_move_batch(g, moves, length, NULL);
+    all_moves += length;
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    if (!valid) {
+        fprintf(stderr, "Invalid move in line %lu of the move log.\n", reader.line);
+    }
+    else if (ferror(file)) {
+        fprintf(stderr, "Cannot read the move log.\n");
+        valid = false;
+    }
+    else {
+        double seconds = (double)(end.tv_sec - start.tv_sec) +
+                         (double)(end.tv_nsec - start.tv_nsec) * 1e-9;
+        game_board_write(g, stdout);
+        print_players_score(g);
+        fprintf(stderr, "Replayed %lu move(s), %lu accepted, in %.3f s (%.0f moves/s).\n",
+                all_moves, accepted_moves, seconds,
+                seconds > 0 ? (double)all_moves / seconds : 0.0);
+
+        game_stats_t stats;
+
+        if (game_stats(g, &stats)) {
+            fprintf(stderr, "Moves: %lu new area, %lu boundary.\n"
+                    "Rejected: %lu invalid, %lu busy, %lu areas, %lu memory.\n"
+                    "Areas: %lu unions, %lu finds, %lu find steps.\n"
+                    "Neighbour lookups: %lu.\n",
+                    stats.new_area_moves, stats.boundary_moves, stats.rejected_invalid,
+                    stats.rejected_busy, stats.rejected_areas, stats.rejected_memory,
+                    stats.area_unions, stats.area_finds, stats.area_find_steps,
+                    stats.neighbour_lookups);
+        }
+    }
+
+    free(reader.buffer);
+    free(moves);
+
+    return valid;
+}
+
+// Deals with the replay mode: ./game --replay width height players areas [file].
+static int replay_mode(const int argc, const char* argv[]) {
+    uint32_t width, height, players, areas;
+    FILE* file = stdin;
+
+    if (argc != 6 && argc != 7) {
+        fprintf(stderr, "Usage: %s %s <width> <height> <players> <areas> [move_log]\n",
+                argv[0], REPLAY_OPTION);
+        return 1;
+    }
+
+    check_game_parameters(5, argv + 1, &width, &height, &players, &areas);
+
+    game_t* g = game_new(width, height, players, areas);
+
+    if (!g) {
+        fprintf(stderr, "Invalid game parameters.\n");
+        return 1;
+    }
+
+    if (argc == 7 && strcmp(argv[6], "-") != 0) {
+        file = fopen(argv[6], "r");
+
+        if (!file) {
+            fprintf(stderr, "Cannot open %s: %s\n", argv[6], strerror(errno));
+            game_delete(g);
+            return 1;
+        }
+    }
+
+    bool valid = replay(g, file);
+
+    if (file != stdin) {
+        fclose(file);
+    }
+
+    game_delete(g);
+
+    return valid ? 0 : 1;
+}
+
 int main(const int argc, const char* argv[]) {
     uint32_t width, height, players, areas;
     game_t* g;
 
-    check_game_parameters(argc, argv, &width, &height, &players, &areas);
+    if (argc > 1 && strcmp(argv[1], REPLAY_OPTION) == 0) {
+        return replay_mode(argc, argv);
+    }
+
+    check_game_parameters(argc > 5 ? 5 : argc, argv, &width, &height, &players, &areas);
     g = game_new(width, height, players, areas);
 
     if (!g) {
@@ -325,15 +852,35 @@ int main(const int argc, const char* argv[]) {
         return 1;
     }
 
-    // Start TUI mode also to check the screen size.
-    start_TUI_mode();
+    uint64_t* bots = calloc(players, sizeof(uint64_t));
+    monte_carlo_t* search = NULL;
+    bool any_bot = false;
+
+    if (!bots) {
+        fprintf(stderr, "Not enough memory.");
+        game_delete(g);
 
-    if (!check_screen(width, height)) {
         return 1;
     }
 
-    print_empty_board(width, height);
-    game_in_TUI_mode(g);
+    check_bot_options(argc - 5, argv + 5, players, bots);
+
+    for (uint32_t i = 0; i < players; i++) {
+        any_bot = any_bot || bots[i] > 0;
+    }
+
+    if (any_bot && !(search = monte_carlo_new(0, (uint64_t)time(NULL)))) {
+        fprintf(stderr, "Not enough memory.");
+        free(bots);
+        game_delete(g);
+
+        return 1;
+    }
+
+    start_TUI_mode();
+    game_in_TUI_mode(g, bots, search);
+    monte_carlo_delete(search);
+    free(bots);
 
     return 0;
 }
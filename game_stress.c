@@ -0,0 +1,674 @@
+/** @file
+ * Stress test of independent games played by many threads.
+ *
+ * Every thread plays its own seeded game, so N games run on N threads at
+ * once. The games are clones of base games prepared before the threads
+ * start and each base game is cloned by two threads, so the pieces shared
+ * by clones are copied and released by different threads. The threads
+ * also read the base games while the others use their clones. After all
+ * threads finish, every game is replayed move by move by one thread and
+ * the results of all moves, the numbers of fields of all players and
+ * the hashes of the boards have to be the same. Small boards are compared
+ * with game_board too.
+ *
+ * Then all threads play one game at once in the concurrent mode (see
+ * game_set_concurrent), on a small board with a low limit of areas and on
+ * a board kept with frontiers. The moves made by the threads must take
+ * different fields, the board must show exactly these fields, no player
+ * may have more areas than the limit, and a game rebuilt by one thread
+ * from these fields in the flood-fill order must have the same numbers of
+ * fields of all players and the same hash.
+ *
+ * The program exits with a failure at the first difference, it is meant
+ * to be run also with the thread sanitizer.
+ *
+ * Usage: ./game_stress [threads [moves [seed]]]
+ */
+
+#include "game.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Describes the maximum possible number of players (see game_new).
+#define STRESS_MAX_PLAYERS 61
+
+// Default number of threads, more than the cores of most machines, so
+// the threads are also switched in the middle of moves.
+#define DEFAULT_THREADS 16
+
+// Default number of moves of every game.
+#define DEFAULT_MOVES 200000
+
+// Default seed of the whole test.
+#define DEFAULT_SEED 2023
+
+// Number of moves made on the base games before the threads start.
+#define BASE_MOVES 2000
+
+// Every such number of moves a thread reads the base game of its neighbour.
+#define READ_INTERVAL 4096
+
+// Boards with at most that many fields are compared with game_board.
+#define BOARD_COMPARE_FIELDS (1U << 16)
+
+/** @brief The parameters of one game.
+ */
+typedef struct Parameters {
+    uint32_t width;
+    uint32_t height;
+    uint32_t players;
+    uint32_t areas;
+} parameters_t;
+
+// The games played by all threads at once in the concurrent mode: most
+// moves on the small board are rejected by the limit of areas, the big
+// board keeps frontiers instead of bitplanes.
+static const parameters_t CONCURRENT_GAMES[] = {
+    {200, 200, 8, 3},
+    {3000, 3000, 16, 200},
+};
+
+/** @brief This structure represents one thread of the test:
+ * base            - the base game of the thread, cloned by this thread
+ *                   and the previous one,
+ * base_hash       - the hash of the base game, which never changes,
+ * next            - the next thread, its base game is read and cloned by
+ *                   this one,
+ * moves, results  - the moves of the game played by the thread and their
+ *                   results, in the order in which they were made,
+ * length          - the number of the moves,
+ * game            - the game played by the thread, a clone of base,
+ * borrowed        - the clone of the base game of the next thread, it gets
+ *                   other moves, so the shared pieces are copied by both
+ *                   threads at once,
+ * seed            - the seed of the moves of the thread,
+ * failed          - true if the base games changed under the thread.
+ */
+typedef struct Worker {
+    parameters_t parameters;
+    game_t* base;
+    uint64_t base_hash;
+    struct Worker const* next;
+    move_t* moves;
+    bool* results;
+    uint64_t length;
+    game_t* game;
+    game_t* borrowed;
+    uint64_t seed;
+    bool failed;
+    pthread_t thread;
+} worker_t;
+
+/** @brief One thread playing the shared game in the concurrent mode:
+ * g               - the shared game,
+ * parameters      - the parameters of the game,
+ * seed            - the seed of the moves of the thread,
+ * length          - the number of the moves,
+ * made            - the moves which were made, in their order,
+ * made_length     - the number of the made moves.
+ */
+typedef struct Sharer {
+    game_t* g;
+    parameters_t const* parameters;
+    uint64_t seed;
+    uint64_t length;
+    move_t* made;
+    uint64_t made_length;
+    pthread_t thread;
+} sharer_t;
+
+/** @brief The board compared with the fields of the made moves:
+ * g               - the game,
+ * owners          - the player of every field (x,y) at x * height + y,
+ *                   zero for a free one,
+ * height          - the height of the board,
+ * same            - false after the first difference.
+ */
+typedef struct Board_check {
+    game_t const* g;
+    uint8_t const* owners;
+    uint32_t height;
+    bool same;
+} board_check_t;
+
+// Returns the next pseudo random number from the state (xorshift64*).
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return *state * 2685821657736338717ULL;
+}
+
+// Mixes the bits of the value (splitmix64), used to derive the seed of
+// every game from the seed of the test.
+static uint64_t mix(uint64_t value) {
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+
+    return value ^ (value >> 31);
+}
+
+// Returns a pseudo random number from the range [min, max].
+static uint32_t draw(uint64_t* state, uint32_t min, uint32_t max) {
+    return min + (uint32_t)(next_random(state) % ((uint64_t)max - min + 1));
+}
+
+// Draws the parameters of a game: every fourth game has a huge sparse
+// board (kept with frontiers), the other ones small boards (bitplanes).
+static parameters_t draw_parameters(uint64_t* state, uint32_t number) {
+    parameters_t p;
+
+    if (number % 4 == 3) {
+        p.width = draw(state, 2000, 6000);
+        p.height = draw(state, 2000, 6000);
+        p.players = draw(state, 2, 16);
+        p.areas = draw(state, 100, 100000);
+    }
+    else {
+        p.width = draw(state, 1, 200);
+        p.height = draw(state, 1, 200);
+        p.players = draw(state, 1, STRESS_MAX_PLAYERS);
+        p.areas = draw(state, 1, 30);
+    }
+
+    return p;
+}
+
+// Draws the next move: half of the moves are neighbours of the previous
+// move, so areas grow and join, the rest are random fields. Some moves
+// are outside the board or of invalid players, they have to be rejected.
+static move_t draw_move(uint64_t* state, parameters_t const* p, move_t const* previous) {
+    static const int dx[] = {1, -1, 0, 0};
+    static const int dy[] = {0, 0, 1, -1};
+    uint64_t value = next_random(state);
+    move_t move;
+
+    move.player = (uint32_t)(value % (p->players + 1));
+
+    if (previous && (value >> 8) % 2 == 0) {
+        move.x = previous->x + (uint32_t)dx[(value >> 9) % 4];
+        move.y = previous->y + (uint32_t)dy[(value >> 9) % 4];
+    }
+    else {
+        move.x = draw(state, 0, p->width);
+        move.y = draw(state, 0, p->height);
+    }
+
+    return move;
+}
+
+// Makes the seeded moves of the base game, the same ones in every run.
+static void prepare_base(game_t* g, parameters_t const* p, uint64_t seed) {
+    uint64_t state = mix(seed) | 1;
+    move_t previous;
+    bool moved = false;
+
+    for (int i = 0; i < BASE_MOVES; i++) {
+        move_t move = draw_move(&state, p, moved ? &previous : NULL);
+
+        if (game_move(g, move.player, move.x, move.y)) {
+            previous = move;
+            moved = true;
+        }
+    }
+}
+
+// Returns true if the base game still has the hash it had before the test.
+static bool unchanged(game_t const* g, uint64_t hash) {
+    return game_hash(g) == hash;
+}
+
+// The main function of every thread: plays the game and records it.
+static void* work(void* argument) {
+    worker_t* worker = argument;
+    parameters_t const* p = &worker->parameters;
+    uint64_t state = mix(worker->seed) | 1;
+    worker_t const* next = worker->next;
+    move_t previous;
+    bool moved = false;
+    move_t borrowed_previous;
+    bool borrowed_moved = false;
+
+    worker->game = game_clone(worker->base);
+    worker->borrowed = game_clone(next->base);
+
+    if (!worker->game || !worker->borrowed) {
+        worker->failed = true;
+        return NULL;
+    }
+
+    for (uint64_t i = 0; i < worker->length; i++) {
+        move_t move = draw_move(&state, p, moved ? &previous : NULL);
+
+        worker->moves[i] = move;
+        worker->results[i] = game_move(worker->game, move.player, move.x, move.y);
+
+        if (worker->results[i]) {
+            previous = move;
+            moved = true;
+        }
+
+        if (i % 2 == 0) {
+            move = draw_move(&state, &next->parameters,
+                             borrowed_moved ? &borrowed_previous : NULL);
+
+            if (game_move(worker->borrowed, move.player, move.x, move.y)) {
+                borrowed_previous = move;
+                borrowed_moved = true;
+            }
+        }
+
+        if (i % READ_INTERVAL == 0) {
+            uint32_t player = 1;
+
+            find_next_player(next->base, &player);
+            game_free_fields(next->base, player);
+            worker->failed |= !unchanged(next->base, next->base_hash) ||
+                              !unchanged(worker->base, worker->base_hash);
+        }
+    }
+
+    // The clone of the neighbour game is released by this thread while
+    // the other one still uses its own clone.
+    game_delete(worker->borrowed);
+    worker->borrowed = NULL;
+
+    return NULL;
+}
+
+// Replays the game of the worker by one thread and compares it with
+// the game played by the worker. Returns false and prints the first
+// difference if they differ.
+static bool replay(worker_t const* worker, uint32_t number) {
+    parameters_t const* p = &worker->parameters;
+    game_t* g = game_new(p->width, p->height, p->players, p->areas);
+    bool same = g != NULL;
+
+    if (same) {
+        prepare_base(g, p, worker->seed ^ 1);
+    }
+
+    for (uint64_t i = 0; same && i < worker->length; i++) {
+        move_t const* move = &worker->moves[i];
+
+        if (game_move(g, move->player, move->x, move->y) != worker->results[i]) {
+            fprintf(stderr, "Game %u differs at move %lu (%u, %u, %u).\n", number, i,
+                    move->player, move->x, move->y);
+            same = false;
+        }
+    }
+
+    for (uint32_t i = 1; same && i <= p->players; i++) {
+        if (game_busy_fields(g, i) != game_busy_fields(worker->game, i) ||
+            game_free_fields(g, i) != game_free_fields(worker->game, i)) {
+            fprintf(stderr, "Game %u differs in the fields of player %u.\n", number, i);
+            same = false;
+        }
+    }
+
+    if (same && game_hash(g) != game_hash(worker->game)) {
+        fprintf(stderr, "Game %u differs in the hash of the board.\n", number);
+        same = false;
+    }
+
+    if (same && (uint64_t)p->width * p->height <= BOARD_COMPARE_FIELDS) {
+        char* expected = game_board(g);
+        char* played = game_board(worker->game);
+
+        if (!expected || !played || strcmp(expected, played) != 0) {
+            fprintf(stderr, "Game %u differs in the board.\n", number);
+            same = false;
+        }
+
+        free(expected);
+        free(played);
+    }
+
+    game_delete(g);
+
+    return same;
+}
+
+// Returns the current time in seconds.
+static double now(void) {
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+// The main function of every thread of the concurrent mode.
+static void* share_game(void* argument) {
+    sharer_t* sharer = argument;
+    uint64_t state = mix(sharer->seed) | 1;
+    move_t previous;
+    bool moved = false;
+
+    for (uint64_t i = 0; i < sharer->length; i++) {
+        move_t move = draw_move(&state, sharer->parameters, moved ? &previous : NULL);
+
+        if (game_move_concurrent(sharer->g, move.player, move.x, move.y)) {
+            sharer->made[sharer->made_length++] = move;
+            previous = move;
+            moved = true;
+        }
+    }
+
+    return NULL;
+}
+
+// Compares the symbols of a part of a row with the players of the fields.
+static bool check_row(void* data, uint32_t y, uint32_t x, char const* symbols,
+                      size_t length) {
+    board_check_t* check = data;
+
+    for (size_t i = 0; i < length; i++) {
+        uint8_t owner = check->owners[(uint64_t)(x + i) * check->height + y];
+
+        check->same &= symbols[i] == game_player(check->g, owner);
+    }
+
+    return check->same;
+}
+
+// Writes the busy fields of the board as the moves of their players in
+// the flood-fill order of every area, so every move after the first one
+// of an area joins that area. Returns the number of moves or UINT64_MAX
+// if some player has more than the given number of areas.
+static uint64_t flood_fill(parameters_t const* p, uint8_t const* owners, move_t* order) {
+    uint64_t fields = (uint64_t)p->width * p->height;
+    bool* visited = calloc(fields, sizeof(bool));
+    uint32_t areas[STRESS_MAX_PLAYERS + 1] = {0};
+    uint64_t length = 0;
+
+    if (!visited) {
+        fprintf(stderr, "Cannot allocate memory.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint64_t first = 0; first < fields; first++) {
+        uint8_t player = owners[first];
+
+        if (player == 0 || visited[first]) {
+            continue;
+        }
+
+        // The moves of the area are its queue.
+        uint64_t head = length;
+
+        areas[player]++;
+        visited[first] = true;
+        order[length++] = (move_t){player, (uint32_t)(first / p->height),
+                                   (uint32_t)(first % p->height)};
+
+        for (; head < length; head++) {
+            static const int dx[] = {1, -1, 0, 0};
+            static const int dy[] = {0, 0, 1, -1};
+
+            for (int i = 0; i < 4; i++) {
+                uint32_t x = order[head].x + (uint32_t)dx[i];
+                uint32_t y = order[head].y + (uint32_t)dy[i];
+                uint64_t index = (uint64_t)x * p->height + y;
+
+                if (x < p->width && y < p->height && !visited[index] &&
+                    owners[index] == player) {
+                    visited[index] = true;
+                    order[length++] = (move_t){player, x, y};
+                }
+            }
+        }
+    }
+
+    free(visited);
+
+    for (uint32_t i = 1; i <= p->players; i++) {
+        if (areas[i] > p->areas) {
+            fprintf(stderr, "Player %u has %u areas, more than %u.\n", i, areas[i], p->areas);
+            return UINT64_MAX;
+        }
+    }
+
+    return length;
+}
+
+// Checks the game played in the concurrent mode against the moves made
+// by the threads and a game rebuilt from them by one thread.
+static bool check_concurrent(game_t const* g, parameters_t const* p, sharer_t const* sharers,
+                             uint32_t threads) {
+    uint64_t fields = (uint64_t)p->width * p->height;
+    uint8_t* owners = calloc(fields, sizeof(uint8_t));
+    move_t* order = malloc(fields * sizeof(move_t));
+    bool same = true;
+
+    if (!owners || !order) {
+        fprintf(stderr, "Cannot allocate memory.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t i = 0; i < threads && same; i++) {
+        for (uint64_t j = 0; j < sharers[i].made_length; j++) {
+            move_t const* move = &sharers[i].made[j];
+            uint64_t index = (uint64_t)move->x * p->height + move->y;
+
+            if (owners[index] != 0) {
+                fprintf(stderr, "The field (%u, %u) was taken twice.\n", move->x, move->y);
+                same = false;
+                break;
+            }
+
+            owners[index] = (uint8_t)move->player;
+        }
+    }
+
+    board_check_t check = {g, owners, p->height, same};
+
+    if (same && !game_board_rows(g, check_row, &check)) {
+        fprintf(stderr, "The board differs from the made moves.\n");
+        same = false;
+    }
+
+    uint64_t length = same ? flood_fill(p, owners, order) : UINT64_MAX;
+    game_t* rebuilt = game_new(p->width, p->height, p->players, p->areas);
+
+    same &= length != UINT64_MAX && rebuilt != NULL;
+
+    for (uint64_t i = 0; same && i < length; i++) {
+        if (!game_move(rebuilt, order[i].player, order[i].x, order[i].y)) {
+            fprintf(stderr, "The rebuilt game rejects the move (%u, %u, %u).\n",
+                    order[i].player, order[i].x, order[i].y);
+            same = false;
+        }
+    }
+
+    for (uint32_t i = 1; same && i <= p->players; i++) {
+        if (game_busy_fields(rebuilt, i) != game_busy_fields(g, i) ||
+            game_free_fields(rebuilt, i) != game_free_fields(g, i)) {
+            fprintf(stderr, "The fields of player %u differ from the rebuilt game.\n", i);
+            same = false;
+        }
+    }
+
+    if (same && game_hash(rebuilt) != game_hash(g)) {
+        fprintf(stderr, "The hash differs from the rebuilt game.\n");
+        same = false;
+    }
+
+    game_delete(rebuilt);
+    free(owners);
+    free(order);
+
+    return same;
+}
+
+// Plays the game with the given parameters by all threads at once in
+// the concurrent mode and checks it. Returns false if the check failed.
+static bool test_concurrent(parameters_t const* p, uint32_t threads, uint64_t moves,
+                            uint64_t seed) {
+    game_t* g = game_new(p->width, p->height, p->players, p->areas);
+    sharer_t* sharers = calloc(threads, sizeof(sharer_t));
+
+    if (!g || !sharers || !game_set_concurrent(g, true)) {
+        fprintf(stderr, "Cannot create the concurrent game.\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (uint32_t i = 0; i < threads; i++) {
+        sharers[i] = (sharer_t){g, p, mix(seed + i), moves, malloc(moves * sizeof(move_t)),
+                                0, 0};
+
+        if (!sharers[i].made) {
+            fprintf(stderr, "Cannot allocate memory.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    double start = now();
+
+    for (uint32_t i = 0; i < threads; i++) {
+        if (pthread_create(&sharers[i].thread, NULL, share_game, &sharers[i]) != 0) {
+            fprintf(stderr, "Cannot create a thread.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    uint64_t made = 0;
+
+    for (uint32_t i = 0; i < threads; i++) {
+        pthread_join(sharers[i].thread, NULL);
+        made += sharers[i].made_length;
+    }
+
+    double seconds = now() - start;
+
+    game_set_concurrent(g, false);
+
+    bool correct = check_concurrent(g, p, sharers, threads);
+
+    printf("Concurrent game %ux%u: threads: %u, moves: %lu, made: %lu, time: %.3f s, "
+           "moves/s: %.1f\n", p->width, p->height, threads, threads * moves, made, seconds,
+           (double)(threads * moves) / seconds);
+
+    for (uint32_t i = 0; i < threads; i++) {
+        free(sharers[i].made);
+    }
+
+    free(sharers);
+    game_delete(g);
+
+    return correct;
+}
+
+// Reads a positive number or exits the program with an error message.
+static uint64_t read_number(const char* string, uint64_t max_value, const char* name) {
+    char* end_string;
+    unsigned long long converted_value = strtoull(string, &end_string, 10);
+
+    if (*string == '\0' || *end_string != '\0' || converted_value == 0 ||
+        converted_value > max_value) {
+        fprintf(stderr, "Invalid %s value: %s\n", name, string);
+        exit(EXIT_FAILURE);
+    }
+
+    return converted_value;
+}
+
+int main(const int argc, const char* argv[]) {
+    if (argc > 4) {
+        fprintf(stderr, "Usage: %s [threads [moves [seed]]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint32_t threads = argc > 1 ? (uint32_t)read_number(argv[1], 1024, "threads") :
+                       DEFAULT_THREADS;
+    uint64_t moves = argc > 2 ? read_number(argv[2], UINT32_MAX, "moves") : DEFAULT_MOVES;
+    uint64_t seed = argc > 3 ? read_number(argv[3], UINT64_MAX, "seed") : DEFAULT_SEED;
+    worker_t* workers = calloc(threads, sizeof(worker_t));
+
+    if (!workers) {
+        fprintf(stderr, "Cannot allocate memory.\n");
+        return EXIT_FAILURE;
+    }
+
+    for (uint32_t i = 0; i < threads; i++) {
+        worker_t* worker = &workers[i];
+        uint64_t state = mix(seed + i) | 1;
+
+        worker->next = &workers[(i + 1) % threads];
+        worker->parameters = draw_parameters(&state, i);
+        worker->seed = next_random(&state);
+        worker->length = moves;
+        worker->moves = malloc(moves * sizeof(move_t));
+        worker->results = malloc(moves * sizeof(bool));
+        worker->base = game_new(worker->parameters.width, worker->parameters.height,
+                                worker->parameters.players, worker->parameters.areas);
+
+        if (!worker->moves || !worker->results || !worker->base) {
+            fprintf(stderr, "Cannot allocate memory.\n");
+            return EXIT_FAILURE;
+        }
+
+        prepare_base(worker->base, &worker->parameters, worker->seed ^ 1);
+        worker->base_hash = game_hash(worker->base);
+    }
+
+    double start = now();
+
+    for (uint32_t i = 0; i < threads; i++) {
+        if (pthread_create(&workers[i].thread, NULL, work, &workers[i]) != 0) {
+            fprintf(stderr, "Cannot create a thread.\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+    for (uint32_t i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    double seconds = now() - start;
+    bool correct = true;
+
+    for (uint32_t i = 0; i < threads; i++) {
+        if (workers[i].failed) {
+            fprintf(stderr, "Game %u could not be cloned or a base game changed.\n", i);
+            correct = false;
+        }
+        else if (!replay(&workers[i], i)) {
+            correct = false;
+        }
+    }
+
+    printf("Games: %u, threads: %u, moves: %lu, time: %.3f s, moves/s: %.1f\n",
+           threads, threads, threads * moves, seconds,
+           (double)(threads * moves) / seconds);
+    printf(correct ? "All games match their single-threaded replays.\n" :
+                     "Some games differ from their single-threaded replays.\n");
+
+    bool concurrent = true;
+
+    for (size_t i = 0; i < sizeof(CONCURRENT_GAMES) / sizeof(CONCURRENT_GAMES[0]); i++) {
+        concurrent &= test_concurrent(&CONCURRENT_GAMES[i], threads, moves,
+                                      mix(seed ^ (i + 1) << 32));
+    }
+
+    printf(concurrent ? "All concurrent games match the made moves and their rebuilds.\n" :
+                        "Some concurrent games differ from the made moves.\n");
+    correct &= concurrent;
+
+    for (uint32_t i = 0; i < threads; i++) {
+        game_delete(workers[i].game);
+        game_delete(workers[i].borrowed);
+        game_delete(workers[i].base);
+        free(workers[i].moves);
+        free(workers[i].results);
+    }
+
+    free(workers);
+
+    return correct ? EXIT_SUCCESS : EXIT_FAILURE;
+}
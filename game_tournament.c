@@ -0,0 +1,515 @@
+/** @file
+ * Headless tournament runner.
+ *
+ * Plays many seeded games between automated players on all processor cores
+ * and reports the number of games and moves per second together with
+ * the win statistics of every player. Each of the game parameters can be
+ * given as a single number or as a range MIN-MAX, then every game draws its
+ * own value from that range. Games are split between the threads with
+ * work-stealing: every thread owns a range of game numbers and a thread
+ * without work steals half of the remaining range of another thread.
+ *
+ * Usage: ./game_tournament games width height players areas [threads [seed]]
+ */
+
+#include "game.h"
+
+#include <pthread.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// Describes the maximum possible number of players (see game_new).
+#define TOURNAMENT_MAX_PLAYERS 61
+
+// Number of random fields tried by a policy before it scans the board.
+#define RANDOM_TRIES 16
+
+// Number of implemented move policies.
+#define NUMBER_OF_POLICIES 2
+
+// Default seed of the whole tournament.
+#define DEFAULT_SEED 2023
+
+// Number of finished games kept by every thread for reuse.
+#define POOL_GAMES 4
+
+/** @brief The range of values of one game parameter.
+ */
+typedef struct Range {
+    uint32_t min;
+    uint32_t max;
+} range_t;
+
+/** @brief Parameters of the whole tournament.
+ */
+typedef struct Tournament {
+    uint64_t games;
+    range_t width;
+    range_t height;
+    range_t players;
+    range_t areas;
+    uint32_t threads;
+    uint64_t seed;
+} tournament_t;
+
+/** @brief Statistics of one player (seat), gathered by one thread and
+ * summed up at the end of the tournament.
+ */
+typedef struct Seat_stats {
+    uint64_t games;
+    uint64_t wins;
+    uint64_t fields;
+} seat_stats_t;
+
+/** @brief This structure represents one thread of the tournament:
+ * lock            - protects begin and end,
+ * begin, end      - the range [begin, end) of game numbers to play,
+ * games, moves    - the number of games and moves played by the thread,
+ * steals          - the number of successful steals of the thread,
+ * failures        - the number of games which could not be created,
+ * seats           - the statistics of all players,
+ * pool            - the finished games of the thread reused by next games
+ *                   of the same size.
+ */
+typedef struct Worker {
+    pthread_mutex_t lock;
+    uint64_t begin;
+    uint64_t end;
+    uint64_t games;
+    uint64_t moves;
+    uint64_t steals;
+    uint64_t failures;
+    seat_stats_t seats[TOURNAMENT_MAX_PLAYERS];
+    game_pool_t* pool;
+    pthread_t thread;
+    uint32_t id;
+    tournament_t const* tournament;
+    struct Worker* all_workers;
+} worker_t;
+
+// Returns the next pseudo random number from the state (xorshift64*).
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return *state * 2685821657736338717ULL;
+}
+
+// Mixes the bits of the value (splitmix64), used to derive the seed of
+// every game from the seed of the tournament.
+static uint64_t mix(uint64_t value) {
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+
+    return value ^ (value >> 31);
+}
+
+// Returns the smaller of two numbers.
+static uint64_t min_u64(uint64_t const x, uint64_t const y) {
+    return x <= y ? x : y;
+}
+
+// Returns a pseudo random number from the range.
+static uint32_t draw(uint64_t* state, range_t range) {
+    return range.min + (uint32_t)(next_random(state) % ((uint64_t)range.max - range.min + 1));
+}
+
+/** @brief The state of one automated player during one game:
+ * last_x, last_y  - the field taken by the previous move of the player
+ *                   or UINT32_MAX if the player has not moved yet.
+ */
+typedef struct Bot {
+    uint32_t last_x;
+    uint32_t last_y;
+} bot_t;
+
+// Tries to make a move and remembers the field if it succeeded.
+static bool try_move(game_t* g, uint32_t player, bot_t* bot, uint32_t x, uint32_t y) {
+    if (!game_move(g, player, x, y)) {
+        return false;
+    }
+
+    bot->last_x = x;
+    bot->last_y = y;
+
+    return true;
+}
+
+// Tries to make a move on some field in the row-major order starting
+// from the random one. Used when random tries failed.
+static bool scan_move(game_t* g, uint32_t player, bot_t* bot, uint64_t* state) {
+    uint32_t width = game_board_width(g);
+    uint64_t fields = (uint64_t)width * (uint64_t)game_board_height(g);
+    uint64_t start = next_random(state) % fields;
+
+    for (uint64_t i = 0; i < fields; i++) {
+        uint64_t index = (start + i) % fields;
+
+        if (try_move(g, player, bot, (uint32_t)(index % width), (uint32_t)(index / width))) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// The random policy: a random field, the board scan when random tries fail.
+static bool random_move(game_t* g, uint32_t player, bot_t* bot, uint64_t* state) {
+    uint32_t width = game_board_width(g);
+    uint32_t height = game_board_height(g);
+
+    for (int i = 0; i < RANDOM_TRIES; i++) {
+        uint64_t value = next_random(state);
+
+        if (try_move(g, player, bot, (uint32_t)(value % width),
+                     (uint32_t)((value >> 32) % height))) {
+            return true;
+        }
+    }
+
+    return scan_move(g, player, bot, state);
+}
+
+// The neighbour policy: prefers the neighbours of the previous move of
+// the player, so the player builds few large areas.
+static bool neighbour_move(game_t* g, uint32_t player, bot_t* bot, uint64_t* state) {
+    static const int dx[] = {1, -1, 0, 0};
+    static const int dy[] = {0, 0, 1, -1};
+
+    if (bot->last_x != UINT32_MAX) {
+        uint32_t first = (uint32_t)(next_random(state) % 4);
+        uint32_t x = bot->last_x;
+        uint32_t y = bot->last_y;
+
+        for (uint32_t i = 0; i < 4; i++) {
+            // Invalid coordinates are rejected by game_move.
+            if (try_move(g, player, bot, x + (uint32_t)dx[(first + i) % 4],
+                         y + (uint32_t)dy[(first + i) % 4])) {
+                return true;
+            }
+        }
+    }
+
+    return random_move(g, player, bot, state);
+}
+
+// Makes a move of the player using the policy assigned to that player.
+static bool bot_move(game_t* g, uint32_t player, bot_t* bot, uint64_t* state) {
+    switch (player % NUMBER_OF_POLICIES) {
+        case 0:
+            return neighbour_move(g, player, bot, state);
+
+        default:
+            return random_move(g, player, bot, state);
+    }
+}
+
+// Plays the game with the given number and adds its results to the worker.
+static void play_game(worker_t* worker, uint64_t number) {
+    tournament_t const* t = worker->tournament;
+    uint64_t state = mix(t->seed ^ mix(number)) | 1;
+    uint32_t width = draw(&state, t->width);
+    uint32_t height = draw(&state, t->height);
+    uint32_t players = draw(&state, t->players);
+    game_t* g = game_pool_get(worker->pool, width, height, players, draw(&state, t->areas));
+    bot_t bots[TOURNAMENT_MAX_PLAYERS];
+    uint32_t current_player = 1;
+
+    if (!g) {
+        worker->failures++;
+        return;
+    }
+
+    for (uint32_t i = 0; i < players; i++) {
+        bots[i].last_x = UINT32_MAX;
+        bots[i].last_y = UINT32_MAX;
+    }
+
+    // At the beginning every player can make a move.
+    do {
+        if (!bot_move(g, current_player, &bots[current_player - 1], &state)) {
+            break;
+        }
+
+        worker->moves++;
+    } while (find_next_player(g, &current_player));
+
+    // The player with the largest number of fields wins, a draw has no winner.
+    uint64_t best = 0;
+    uint32_t winners = 0;
+    uint32_t winner = 0;
+
+    for (uint32_t i = 1; i <= players; i++) {
+        uint64_t fields = game_busy_fields(g, i);
+
+        worker->seats[i - 1].games++;
+        worker->seats[i - 1].fields += fields;
+
+        if (fields > best) {
+            best = fields;
+            winners = 1;
+            winner = i;
+        }
+        else if (fields == best) {
+            winners++;
+        }
+    }
+
+    if (winners == 1) {
+        worker->seats[winner - 1].wins++;
+    }
+
+    worker->games++;
+    game_pool_put(worker->pool, g);
+}
+
+// Takes the next game number from the worker's own range.
+static bool take_own(worker_t* worker, uint64_t* number) {
+    bool success = false;
+
+    pthread_mutex_lock(&worker->lock);
+
+    if (worker->begin < worker->end) {
+        *number = worker->begin++;
+        success = true;
+    }
+
+    pthread_mutex_unlock(&worker->lock);
+
+    return success;
+}
+
+// Steals half of the remaining range of some other worker and makes it
+// the worker's own range. Returns false if all the other workers are idle.
+static bool steal(worker_t* worker, uint64_t* state) {
+    uint32_t threads = worker->tournament->threads;
+    uint32_t first = (uint32_t)(next_random(state) % threads);
+
+    for (uint32_t i = 0; i < threads; i++) {
+        worker_t* victim = &worker->all_workers[(first + i) % threads];
+        uint64_t begin = 0;
+        uint64_t end = 0;
+
+        if (victim == worker) {
+            continue;
+        }
+
+        pthread_mutex_lock(&victim->lock);
+
+        if (victim->begin < victim->end) {
+            end = victim->end;
+            begin = end - (victim->end - victim->begin + 1) / 2;
+            victim->end = begin;
+        }
+
+        pthread_mutex_unlock(&victim->lock);
+
+        if (begin < end) {
+            pthread_mutex_lock(&worker->lock);
+            worker->begin = begin;
+            worker->end = end;
+            pthread_mutex_unlock(&worker->lock);
+            worker->steals++;
+
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// The main function of every thread. Work is never added, so a thread
+// which finds no work to steal can finish.
+static void* work(void* argument) {
+    worker_t* worker = argument;
+    uint64_t state = mix(worker->tournament->seed + worker->id) | 1;
+    uint64_t number;
+
+    // Without a pool every game is created and deleted.
+    worker->pool = game_pool_new(POOL_GAMES);
+
+    do {
+        while (take_own(worker, &number)) {
+            play_game(worker, number);
+        }
+    } while (steal(worker, &state));
+
+    game_pool_delete(worker->pool);
+
+    return NULL;
+}
+
+// Reads a positive number or exits the program with an error message.
+static uint64_t read_number(const char* string, uint64_t max_value, const char* name) {
+    char* end_string;
+    unsigned long long converted_value = strtoull(string, &end_string, 10);
+
+    if (*string == '\0' || *end_string != '\0' || converted_value == 0 ||
+        converted_value > max_value) {
+        fprintf(stderr, "Invalid %s value: %s\n", name, string);
+        exit(EXIT_FAILURE);
+    }
+
+    return converted_value;
+}
+
+// Reads a number N or a range MIN-MAX of positive uint32_t numbers.
+static range_t read_range(const char* string, const char* name) {
+    char buffer[64];
+    const char* dash = strchr(string, '-');
+    range_t range;
+
+    if (!dash) {
+        range.min = range.max = (uint32_t)read_number(string, UINT32_MAX, name);
+
+        return range;
+    }
+    if ((size_t)(dash - string) >= sizeof(buffer)) {
+        fprintf(stderr, "Invalid %s value: %s\n", name, string);
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(buffer, string, (size_t)(dash - string));
+    buffer[dash - string] = '\0';
+    range.min = (uint32_t)read_number(buffer, UINT32_MAX, name);
+    range.max = (uint32_t)read_number(dash + 1, UINT32_MAX, name);
+
+    if (range.min > range.max) {
+        fprintf(stderr, "Invalid %s value: %s\n", name, string);
+        exit(EXIT_FAILURE);
+    }
+
+    return range;
+}
+
+// Checks the program parameters and fills the tournament structure.
+static void check_tournament_parameters(const int argc, const char** argv,
+                                        tournament_t* t) {
+    if (argc < 6 || argc > 8) {
+        fprintf(stderr, "Usage: %s <games> <width> <height> <players> <areas> "
+                        "[threads [seed]]\n"
+                        "Each of width, height, players and areas can be "
+                        "a number N or a range MIN-MAX.\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+
+    long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+    t->games = read_number(argv[1], UINT64_MAX, "games");
+    t->width = read_range(argv[2], "width");
+    t->height = read_range(argv[3], "height");
+    t->players = read_range(argv[4], "players");
+    t->areas = read_range(argv[5], "areas");
+    t->threads = argc > 6 ? (uint32_t)read_number(argv[6], 1024, "threads") :
+                 (cores > 0 ? (uint32_t)cores : 1);
+    t->seed = argc > 7 ? read_number(argv[7], UINT64_MAX, "seed") : DEFAULT_SEED;
+
+    if (t->players.max > TOURNAMENT_MAX_PLAYERS) {
+        fprintf(stderr, "Invalid players value: %s\n", argv[4]);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Returns the current time in seconds.
+static double now(void) {
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (double)time.tv_sec + (double)time.tv_nsec * 1e-9;
+}
+
+// Sums up the statistics of all workers and prints them.
+static void print_results(tournament_t const* t, worker_t const* workers, double seconds) {
+    seat_stats_t seats[TOURNAMENT_MAX_PLAYERS];
+    uint64_t games = 0;
+    uint64_t moves = 0;
+    uint64_t failures = 0;
+
+    memset(seats, 0, sizeof(seats));
+
+    for (uint32_t i = 0; i < t->threads; i++) {
+        games += workers[i].games;
+        moves += workers[i].moves;
+        failures += workers[i].failures;
+
+        for (uint32_t j = 0; j < TOURNAMENT_MAX_PLAYERS; j++) {
+            seats[j].games += workers[i].seats[j].games;
+            seats[j].wins += workers[i].seats[j].wins;
+            seats[j].fields += workers[i].seats[j].fields;
+        }
+    }
+
+    printf("Games: %lu, moves: %lu, threads: %u, time: %.3f s\n",
+           games, moves, t->threads, seconds);
+    printf("Games/s: %.1f, moves/s: %.1f\n", games / seconds, moves / seconds);
+
+    if (failures > 0) {
+        printf("Games which could not be created: %lu\n", failures);
+    }
+
+    for (uint32_t i = 0; i < t->threads; i++) {
+        printf("Thread %u played %lu game(s) and stole work %lu time(s)\n",
+               i, workers[i].games, workers[i].steals);
+    }
+
+    for (uint32_t j = 0; j < TOURNAMENT_MAX_PLAYERS; j++) {
+        if (seats[j].games > 0) {
+            printf("Player %u (%s policy) won %lu of %lu game(s) (%.2f%%), "
+                   "average fields: %.2f\n", j + 1,
+                   (j + 1) % NUMBER_OF_POLICIES == 0 ? "neighbour" : "random",
+                   seats[j].wins, seats[j].games,
+                   100.0 * (double)seats[j].wins / (double)seats[j].games,
+                   (double)seats[j].fields / (double)seats[j].games);
+        }
+    }
+}
+
+int main(const int argc, const char* argv[]) {
+    tournament_t t;
+
+    check_tournament_parameters(argc, argv, &t);
+
+    worker_t* workers = calloc(t.threads, sizeof(worker_t));
+
+    if (!workers) {
+        fprintf(stderr, "Cannot allocate memory.\n");
+        return 1;
+    }
+
+    // Split the games evenly, stealing balances the different game lengths.
+    for (uint32_t i = 0; i < t.threads; i++) {
+        pthread_mutex_init(&workers[i].lock, NULL);
+        workers[i].begin = t.games / t.threads * i + min_u64(i, t.games % t.threads);
+        workers[i].end = workers[i].begin + t.games / t.threads + (i < t.games % t.threads);
+        workers[i].id = i;
+        workers[i].tournament = &t;
+        workers[i].all_workers = workers;
+    }
+
+    double start = now();
+
+    for (uint32_t i = 0; i < t.threads; i++) {
+        if (pthread_create(&workers[i].thread, NULL, work, &workers[i]) != 0) {
+            fprintf(stderr, "Cannot create a thread.\n");
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    for (uint32_t i = 0; i < t.threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+    }
+
+    print_results(&t, workers, now() - start);
+
+    for (uint32_t i = 0; i < t.threads; i++) {
+        pthread_mutex_destroy(&workers[i].lock);
+    }
+
+    free(workers);
+
+    return 0;
+}
@@ -0,0 +1,78 @@
+/** @file
+ * Memory usage report of the game engine.
+ *
+ * For every given board size (a square board) prints the memory needed
+ * by the previous board layout (16 bytes per field and a column pointer
+ * table), the memory used by an empty game and the memory used after
+ * filling the given percent of the fields.
+ *
+ * Usage: ./memory_report [percent [size...]]
+ */
+
+#include "game.h"
+
+// Board sizes used when none is given on the command line.
+static const uint32_t DEFAULT_SIZES[] = {1000, 5000, 20000};
+
+// Percent of fields filled when it is not given on the command line.
+#define DEFAULT_PERCENT 10
+
+// Reads a positive number not greater than max_value from the string
+// or exits the program with an error message.
+static uint32_t read_number(const char* string, uint32_t max_value) {
+    char* end_string;
+    unsigned long converted_value = strtoul(string, &end_string, 10);
+
+    if (*end_string != '\0' || converted_value == 0 || converted_value > max_value) {
+        fprintf(stderr, "Invalid value: %s\n", string);
+        exit(EXIT_FAILURE);
+    }
+
+    return (uint32_t)converted_value;
+}
+
+// Prints one line of the report for the board size x size.
+static void report(uint32_t size, uint32_t percent) {
+    uint64_t fields = (uint64_t)size * (uint64_t)size;
+    uint64_t to_fill = fields / 100 * percent + fields % 100 * percent / 100;
+    uint64_t old_layout = fields * 16 + (uint64_t)size * sizeof(void*);
+    game_t* g = game_new(size, size, 1, 1);
+
+    if (!g) {
+        fprintf(stderr, "Cannot create the %ux%u board.\n", size, size);
+        exit(EXIT_FAILURE);
+    }
+
+    uint64_t empty = game_memory_usage(g);
+
+    // Fill the fields column by column, so all of them form one area.
+    for (uint64_t i = 0; i < to_fill; i++) {
+        game_move(g, 1, (uint32_t)(i / size), (uint32_t)(i % size));
+    }
+
+    uint64_t filled = game_memory_usage(g);
+
+    printf("%10u %16lu %16lu %16lu %10.2f\n", size, old_layout, empty, filled,
+           to_fill ? (double)(filled - empty) / (double)to_fill : 0.0);
+    game_delete(g);
+}
+
+int main(const int argc, const char* argv[]) {
+    uint32_t percent = argc > 1 ? read_number(argv[1], 100) : DEFAULT_PERCENT;
+
+    printf("%10s %16s %16s %16s %10s\n", "size", "old layout", "empty game",
+           "filled game", "B/filled");
+
+    if (argc > 2) {
+        for (int i = 2; i < argc; i++) {
+            report(read_number(argv[i], UINT32_MAX), percent);
+        }
+    }
+    else {
+        for (size_t i = 0; i < sizeof(DEFAULT_SIZES) / sizeof(DEFAULT_SIZES[0]); i++) {
+            report(DEFAULT_SIZES[i], percent);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,466 @@
+/** @file
+ * Implementation of the interface monte_carlo.h
+ *
+ * Flat Monte Carlo search: every thread keeps its own copy of the position
+ * with the journal on, plays a random game after a candidate move and undoes
+ * it, so the playouts allocate memory only for the first moves. Candidates
+ * are taken in turns, so all of them get the same number of playouts.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include "monte_carlo.h"
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <time.h>
+#include <unistd.h>
+
+// The number of moves compared by one search.
+#define MONTE_CARLO_CANDIDATES 64
+
+// A player with at most that many legal moves has all of them enumerated
+// before the candidates are drawn, otherwise random fields are tried.
+#define ENUMERATED_MOVES (1 << 16)
+
+// The number of moves of a playout after which the game is scored.
+#define PLAYOUT_MOVES 256
+
+// Number of random fields tried by a playout move before it takes one
+// of the first FALLBACK_MOVES legal moves.
+#define RANDOM_TRIES 16
+#define FALLBACK_MOVES 64
+
+// Describes the maximum possible number of players (see game_new).
+#define MONTE_CARLO_MAX_PLAYERS 61
+
+// The maximal number of threads of one search.
+#define MAX_THREADS 1024
+
+// The points of a playout: a win, a draw and a loss of the searching player.
+#define WIN_POINTS 2
+#define DRAW_POINTS 1
+
+/** @brief One compared move:
+ * move            - the move,
+ * playouts        - the number of playouts started by that move,
+ * points          - the sum of their points (see WIN_POINTS).
+ */
+typedef struct Candidate {
+    move_t move;
+    atomic_uint_fast64_t playouts;
+    atomic_uint_fast64_t points;
+} candidate_t;
+
+/** @brief One thread of the search:
+ * search          - the search the thread belongs to,
+ * g               - the copy of the position used only by that thread,
+ * state           - the state of its random number generator,
+ * last            - the last move of every player in the current playout,
+ *                   with x equal to UINT32_MAX before his first move.
+ */
+typedef struct Worker {
+    struct monte_carlo* search;
+    game_t* g;
+    uint64_t state;
+    move_t last[MONTE_CARLO_MAX_PLAYERS];
+    pthread_t thread;
+} worker_t;
+
+/** @brief This structure represents the search:
+ * threads, workers - the threads of the search,
+ * seed            - the seed of the next search,
+ * running         - true between monte_carlo_start and monte_carlo_finish,
+ * deadline        - the end of the search (see nanoseconds),
+ * stop            - set to interrupt the search,
+ * next            - the number of the next playout, it chooses the candidate,
+ * playouts        - the number of finished playouts,
+ * candidates      - the first length candidates are compared.
+ */
+struct monte_carlo {
+    uint32_t threads;
+    worker_t* workers;
+    uint64_t seed;
+    bool running;
+    int64_t deadline;
+    atomic_bool stop;
+    atomic_uint_fast64_t next;
+    atomic_uint_fast64_t playouts;
+    uint32_t length;
+    candidate_t candidates[MONTE_CARLO_CANDIDATES];
+};
+
+// Returns the number of nanoseconds from some fixed point in the past.
+static int64_t nanoseconds(void) {
+    struct timespec time;
+
+    clock_gettime(CLOCK_MONOTONIC, &time);
+
+    return (int64_t)time.tv_sec * 1000000000 + time.tv_nsec;
+}
+
+// Returns the next pseudo random number from the state (xorshift64*).
+static uint64_t next_random(uint64_t* state) {
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+
+    return *state * 2685821657736338717ULL;
+}
+
+// Mixes the bits of the value (splitmix64), used to derive the seeds
+// of the threads, a seed is never zero.
+static uint64_t mix(uint64_t value) {
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+
+    return (value ^ (value >> 31)) | 1;
+}
+
+monte_carlo_t* monte_carlo_new(uint32_t threads, uint64_t seed) {
+    if (threads == 0) {
+        long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+        threads = cores > 0 ? (uint32_t)cores : 1;
+    }
+
+    threads = threads < MAX_THREADS ? threads : MAX_THREADS;
+
+    monte_carlo_t* search = calloc(1, sizeof(monte_carlo_t));
+    worker_t* workers = calloc(threads, sizeof(worker_t));
+
+    if (!search || !workers) {
+        free(search);
+        free(workers);
+
+        return NULL;
+    }
+
+    search->threads = threads;
+    search->workers = workers;
+    search->seed = seed;
+    atomic_init(&search->stop, false);
+    atomic_init(&search->next, 0);
+    atomic_init(&search->playouts, 0);
+
+    return search;
+}
+
+void monte_carlo_delete(monte_carlo_t* search) {
+    if (search) {
+        move_t move;
+
+        monte_carlo_finish(search, true, &move);
+        free(search->workers);
+        free(search);
+    }
+}
+
+// Adds the move to the candidates.
+static void add_candidate(monte_carlo_t* search, move_t const move) {
+    candidate_t* candidate = &search->candidates[search->length++];
+
+    candidate->move = move;
+    atomic_init(&candidate->playouts, 0);
+    atomic_init(&candidate->points, 0);
+}
+
+// Chooses the candidates among the legal moves of the player. Returns
+// false if there is none or the allocation failed.
+static bool choose_candidates(monte_carlo_t* search, game_t const* g, uint32_t player,
+                              uint64_t* state) {
+    uint64_t fields = game_free_fields(g, player);
+
+    search->length = 0;
+
+    if (fields == 0) {
+        return false;
+    }
+
+    if (fields <= ENUMERATED_MOVES) {
+        move_t* moves = malloc(fields * sizeof(move_t));
+
+        if (!moves) {
+            return false;
+        }
+
+        uint64_t length = game_legal_moves(g, player, moves, fields);
+
+        length = length < fields ? length : fields;
+
+        // A partial Fisher-Yates shuffle draws the candidates uniformly.
+        for (uint64_t i = 0; i < length && search->length < MONTE_CARLO_CANDIDATES; i++) {
+            uint64_t j = i + next_random(state) % (length - i);
+            move_t chosen = moves[j];
+
+            moves[j] = moves[i];
+            add_candidate(search, chosen);
+        }
+
+        free(moves);
+
+        return search->length > 0;
+    }
+
+    // Most fields are legal, so random fields are checked.
+    uint32_t width = game_board_width(g);
+    uint32_t height = game_board_height(g);
+
+    for (int i = 0; i < MONTE_CARLO_CANDIDATES * RANDOM_TRIES &&
+                    search->length < MONTE_CARLO_CANDIDATES; i++) {
+        uint64_t value = next_random(state);
+        move_t move = {player, (uint32_t)(value % width), (uint32_t)((value >> 32) % height)};
+
+        if (game_move_preview(g, player, move.x, move.y, NULL)) {
+            add_candidate(search, move);
+        }
+    }
+
+    if (search->length == 0) {
+        move_t moves[MONTE_CARLO_CANDIDATES];
+        uint64_t length = game_legal_moves(g, player, moves, MONTE_CARLO_CANDIDATES);
+
+        for (uint64_t i = 0; i < length && i < MONTE_CARLO_CANDIDATES; i++) {
+            add_candidate(search, moves[i]);
+        }
+    }
+
+    return search->length > 0;
+}
+
+// Makes the move and remembers it as the last move of the player.
+static bool try_move(worker_t* worker, uint32_t player, uint32_t x, uint32_t y) {
+    if (!game_move(worker->g, player, x, y)) {
+        return false;
+    }
+
+    worker->last[player - 1].x = x;
+    worker->last[player - 1].y = y;
+
+    return true;
+}
+
+/** @brief Makes a random move of the player. Prefers the neighbours of his
+ * last move, which are legal also when he took all his areas, then random
+ * fields and only then enumerates his legal moves.
+ * @param worker    - the thread playing the game,
+ * @param player    - the player making the move.
+ * @return false if the player has no move.
+ */
+static bool random_move(worker_t* worker, uint32_t player) {
+    static const int dx[] = {1, -1, 0, 0};
+    static const int dy[] = {0, 0, 1, -1};
+    game_t* g = worker->g;
+    move_t const last = worker->last[player - 1];
+    uint32_t width = game_board_width(g);
+    uint32_t height = game_board_height(g);
+
+    if (last.x != UINT32_MAX) {
+        uint32_t first = (uint32_t)(next_random(&worker->state) % 4);
+
+        for (uint32_t i = 0; i < 4; i++) {
+            // Invalid coordinates are rejected by game_move.
+            if (try_move(worker, player, last.x + (uint32_t)dx[(first + i) % 4],
+                         last.y + (uint32_t)dy[(first + i) % 4])) {
+                return true;
+            }
+        }
+    }
+
+    for (int i = 0; i < RANDOM_TRIES; i++) {
+        uint64_t value = next_random(&worker->state);
+
+        if (try_move(worker, player, (uint32_t)(value % width),
+                     (uint32_t)((value >> 32) % height))) {
+            return true;
+        }
+    }
+
+    move_t moves[FALLBACK_MOVES];
+    uint64_t length = game_legal_moves(g, player, moves, FALLBACK_MOVES);
+
+    if (length == 0) {
+        return false;
+    }
+
+    length = length < FALLBACK_MOVES ? length : FALLBACK_MOVES;
+
+    move_t const* move = &moves[next_random(&worker->state) % length];
+
+    return try_move(worker, player, move->x, move->y);
+}
+
+// Returns the points of the player in the current position: the player
+// with the most fields wins.
+static uint64_t score(game_t const* g, uint32_t player) {
+    uint64_t own = game_busy_fields(g, player);
+    uint64_t best = 0;
+
+    for (uint32_t i = 1; i <= game_players(g); i++) {
+        if (i != player && game_busy_fields(g, i) > best) {
+            best = game_busy_fields(g, i);
+        }
+    }
+
+    return own > best ? WIN_POINTS : own == best ? DRAW_POINTS : 0;
+}
+
+/** @brief Plays a random game after the move and undoes it.
+ * @param worker    - the thread playing the game,
+ * @param move      - the first move, legal in the position of the worker,
+ * @param points    - the place for the points of the game.
+ * @return false if the position could not be restored (no memory).
+ */
+static bool playout(worker_t* worker, move_t const* move, uint64_t* points) {
+    game_t* g = worker->g;
+    uint32_t current = move->player;
+    uint64_t made = 0;
+
+    for (uint32_t i = 0; i < game_players(g); i++) {
+        worker->last[i].x = UINT32_MAX;
+    }
+
+    if (try_move(worker, move->player, move->x, move->y)) {
+        made++;
+
+        while (made < PLAYOUT_MOVES && find_next_player(g, &current) &&
+               random_move(worker, current)) {
+            made++;
+        }
+    }
+
+    *points = score(g, move->player);
+
+    for (; made > 0; made--) {
+        if (!game_undo(g)) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+// The thread of the search, plays until the deadline.
+static void* work(void* data) {
+    worker_t* worker = data;
+    monte_carlo_t* search = worker->search;
+
+    while (!atomic_load_explicit(&search->stop, memory_order_relaxed) &&
+           nanoseconds() < search->deadline) {
+        uint64_t number = atomic_fetch_add_explicit(&search->next, 1, memory_order_relaxed);
+        candidate_t* candidate = &search->candidates[number % search->length];
+        uint64_t points;
+
+        if (!playout(worker, &candidate->move, &points)) {
+            break;
+        }
+
+        atomic_fetch_add_explicit(&candidate->points, points, memory_order_relaxed);
+        atomic_fetch_add_explicit(&candidate->playouts, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&search->playouts, 1, memory_order_relaxed);
+    }
+
+    return NULL;
+}
+
+// Waits for the first started threads and deletes the copies of all workers.
+static void join_workers(monte_carlo_t* search, uint32_t started) {
+    for (uint32_t i = 0; i < started; i++) {
+        pthread_join(search->workers[i].thread, NULL);
+    }
+
+    for (uint32_t i = 0; i < search->threads; i++) {
+        game_delete(search->workers[i].g);
+        search->workers[i].g = NULL;
+    }
+}
+
+bool monte_carlo_start(monte_carlo_t* search, game_t const* g, uint32_t player,
+                       uint64_t milliseconds) {
+    if (!search || !g || search->running) {
+        return false;
+    }
+
+    uint64_t state = search->seed = mix(search->seed);
+
+    if (!choose_candidates(search, g, player, &state)) {
+        return false;
+    }
+
+    atomic_store(&search->stop, false);
+    atomic_store(&search->next, 0);
+    atomic_store(&search->playouts, 0);
+    search->deadline = nanoseconds() + (int64_t)milliseconds * 1000000;
+
+    // The copies are made here, so only this thread reads the game.
+    for (uint32_t i = 0; i < search->threads; i++) {
+        worker_t* worker = &search->workers[i];
+
+        worker->search = search;
+        worker->state = mix(state + i);
+        worker->g = game_clone(g);
+
+        if (!worker->g) {
+            join_workers(search, 0);
+
+            return false;
+        }
+
+        game_set_journal(worker->g, true);
+    }
+
+    for (uint32_t i = 0; i < search->threads; i++) {
+        if (pthread_create(&search->workers[i].thread, NULL, work, &search->workers[i]) != 0) {
+            atomic_store(&search->stop, true);
+            join_workers(search, i);
+
+            return false;
+        }
+    }
+
+    search->running = true;
+
+    return true;
+}
+
+bool monte_carlo_done(monte_carlo_t const* search) {
+    return !search->running || nanoseconds() >= search->deadline;
+}
+
+uint64_t monte_carlo_playouts(monte_carlo_t const* search) {
+    return atomic_load_explicit(&search->playouts, memory_order_relaxed);
+}
+
+bool monte_carlo_finish(monte_carlo_t* search, bool stop, move_t* move) {
+    if (!search->running) {
+        return false;
+    }
+
+    if (stop) {
+        atomic_store(&search->stop, true);
+    }
+
+    join_workers(search, search->threads);
+    search->running = false;
+
+    // The candidate with the best average of points, the ones without
+    // playouts are chosen only if no candidate has any.
+    candidate_t const* best = &search->candidates[0];
+
+    for (uint32_t i = 1; i < search->length; i++) {
+        candidate_t const* candidate = &search->candidates[i];
+        uint64_t playouts = atomic_load(&candidate->playouts);
+        uint64_t best_playouts = atomic_load(&best->playouts);
+
+        if (playouts > 0 && (best_playouts == 0 ||
+            atomic_load(&candidate->points) * best_playouts >
+            atomic_load(&best->points) * playouts)) {
+            best = candidate;
+        }
+    }
+
+    *move = best->move;
+
+    return true;
+}
@@ -0,0 +1,74 @@
+#ifndef MONTE_CARLO_H
+#define MONTE_CARLO_H
+
+#include "game.h"
+
+/**
+ * Przeszukiwanie Monte Carlo: wybór ruchu gracza komputerowego na podstawie
+ * losowych rozgrywek. Z danej pozycji wybieranych jest kilkadziesiąt legalnych
+ * ruchów, a wątki na wszystkich rdzeniach rozgrywają po każdym z nich losowe
+ * partie (skrócone do ustalonej liczby ruchów) i liczą, jak często gracz
+ * zajmuje w nich najwięcej pól. Wybierany jest ruch o największym odsetku
+ * wygranych. Przeszukiwanie działa w tle, więc wątek, który je uruchomił,
+ * może w tym czasie obsługiwać użytkownika.
+ */
+typedef struct monte_carlo monte_carlo_t;
+
+/** @brief Tworzy strukturę przeszukiwania.
+ * @param[in] threads – liczba wątków przeszukiwania lub zero, aby użyć
+ *                      wszystkich rdzeni procesora,
+ * @param[in] seed    – ziarno generatora liczb losowych.
+ * @return Wskaźnik na utworzoną strukturę lub NULL, gdy nie udało się alokować
+ * pamięci.
+ */
+monte_carlo_t* monte_carlo_new(uint32_t threads, uint64_t seed);
+
+/** @brief Usuwa strukturę przeszukiwania, przerywając trwające przeszukiwanie.
+ * Nic nie robi, jeśli wskaźnik ma wartość NULL.
+ * @param[in] search  – wskaźnik na usuwaną strukturę.
+ */
+void monte_carlo_delete(monte_carlo_t *search);
+
+/** @brief Rozpoczyna w tle szukanie ruchu gracza.
+ * Przeszukiwanie używa kopii gry @p g (zob. @ref game_clone), więc grę można
+ * w tym czasie czytać, ale nie wolno jej zmieniać ani usuwać przed
+ * zakończeniem przeszukiwania.
+ * @param[in,out] search – wskaźnik na strukturę przeszukiwania, w której nie
+ *                         trwa inne przeszukiwanie,
+ * @param[in] g          – wskaźnik na strukturę przechowującą stan gry,
+ * @param[in] player     – numer gracza, który wykonuje ruch,
+ * @param[in] milliseconds – czas przeszukiwania w milisekundach.
+ * @return Wartość @p true, jeśli przeszukiwanie się rozpoczęło, a @p false,
+ * gdy gracz nie ma legalnego ruchu lub nie udało się alokować pamięci
+ * albo utworzyć wątków.
+ */
+bool monte_carlo_start(monte_carlo_t *search, game_t const *g, uint32_t player,
+                       uint64_t milliseconds);
+
+/** @brief Sprawdza, czy przeszukiwanie się zakończyło.
+ * Nie czeka na zakończenie przeszukiwania.
+ * @param[in] search  – wskaźnik na strukturę przeszukiwania.
+ * @return Wartość @p true, jeśli minął czas przeszukiwania lub żadne
+ * przeszukiwanie nie trwa, a @p false w przeciwnym przypadku.
+ */
+bool monte_carlo_done(monte_carlo_t const *search);
+
+/** @brief Podaje liczbę rozegranych losowych partii.
+ * @param[in] search  – wskaźnik na strukturę przeszukiwania.
+ * @return Liczba partii rozegranych od rozpoczęcia ostatniego przeszukiwania.
+ */
+uint64_t monte_carlo_playouts(monte_carlo_t const *search);
+
+/** @brief Kończy przeszukiwanie i podaje najlepszy znaleziony ruch.
+ * Czeka, aż minie czas przeszukiwania, chyba że @p stop ma wartość @p true,
+ * wtedy przerywa je od razu.
+ * @param[in,out] search – wskaźnik na strukturę przeszukiwania,
+ * @param[in] stop       – wartość @p true, aby przerwać przeszukiwanie,
+ * @param[out] move      – wskaźnik, pod który jest wpisywany ruch o największym
+ *                         odsetku wygranych.
+ * @return Wartość @p true, jeśli ruch został wpisany, a @p false, gdy żadne
+ * przeszukiwanie nie trwało.
+ */
+bool monte_carlo_finish(monte_carlo_t *search, bool stop, move_t *move);
+
+#endif /* MONTE_CARLO_H */
@@ -0,0 +1,97 @@
+/** @file
+ * Implementation of the interface transposition.h
+ *
+ * A fixed-size table of positions for search bots running in many threads,
+ * the entries are validated with the xor trick instead of being locked.
+ */
+
+#include "transposition.h"
+
+#include <stdatomic.h>
+#include <stdlib.h>
+
+/** @brief One entry of the table:
+ * check           - the complement of the xor of the hash and the value,
+ * value           - the stored value.
+ * Both words are written and read separately without locks, so an entry
+ * written by two threads at once may hold the check of one position and
+ * the value of the other one. Such entry does not match any of them, since
+ * the check is computed from the value read. A zeroed entry matches only
+ * the hash UINT64_MAX, thanks to the complement it is not the hash 0
+ * of the empty board.
+ */
+typedef struct Entry {
+    atomic_uint_fast64_t check;
+    atomic_uint_fast64_t value;
+} entry_t;
+
+/** @brief The transposition table:
+ * mask            - the number of entries minus one, a power of two minus one,
+ * entries         - the entries, the position with the hash h is kept
+ *                   in the entry h & mask.
+ */
+struct transposition_table {
+    uint64_t mask;
+    entry_t entries[];
+};
+
+transposition_table_t* transposition_new(size_t entries) {
+    if (entries == 0 || entries > (SIZE_MAX - sizeof(transposition_table_t)) /
+                                  sizeof(entry_t) / 2) {
+        return NULL;
+    }
+
+    size_t length = 1;
+
+    while (length < entries) {
+        length *= 2;
+    }
+
+    transposition_table_t* table = calloc(1, sizeof(transposition_table_t) +
+                                             length * sizeof(entry_t));
+
+    if (!table) {
+        return NULL;
+    }
+
+    table->mask = length - 1;
+
+    return table;
+}
+
+void transposition_delete(transposition_table_t* table) {
+    free(table);
+}
+
+void transposition_clear(transposition_table_t* table) {
+    for (uint64_t i = 0; i <= table->mask; i++) {
+        atomic_store_explicit(&table->entries[i].check, 0, memory_order_relaxed);
+        atomic_store_explicit(&table->entries[i].value, 0, memory_order_relaxed);
+    }
+}
+
+void transposition_store(transposition_table_t* table, uint64_t hash, uint64_t value) {
+    entry_t* entry = &table->entries[hash & table->mask];
+
+    atomic_store_explicit(&entry->value, value, memory_order_relaxed);
+    atomic_store_explicit(&entry->check, ~(hash ^ value), memory_order_relaxed);
+}
+
+bool transposition_probe(transposition_table_t const* table, uint64_t hash,
+                         uint64_t* value) {
+    entry_t const* entry = &table->entries[hash & table->mask];
+    uint64_t check = atomic_load_explicit(&entry->check, memory_order_relaxed);
+    uint64_t stored = atomic_load_explicit(&entry->value, memory_order_relaxed);
+
+    if (~(check ^ stored) != hash) {
+        return false;
+    }
+
+    *value = stored;
+
+    return true;
+}
+
+uint64_t transposition_memory_usage(transposition_table_t const* table) {
+    return table ? sizeof(transposition_table_t) + (table->mask + 1) * sizeof(entry_t) : 0;
+}
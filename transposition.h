@@ -0,0 +1,66 @@
+#ifndef TRANSPOSITION_H
+#define TRANSPOSITION_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/**
+ * Tablica transpozycji: tablica stałego rozmiaru przechowująca wartości
+ * pozycji gry (na przykład ocenę i głębokość przeszukiwania zapisane w jednym
+ * słowie) według ich skrótów zwracanych przez funkcję @ref game_hash.
+ * Tablica nie używa blokad, więc wiele wątków przeszukujących grę może
+ * jednocześnie z niej czytać i do niej pisać. Nowy wpis zastępuje wpis
+ * o tym samym indeksie, a wpis uszkodzony przez jednoczesne zapisy jest
+ * rozpoznawany i pomijany.
+ */
+typedef struct transposition_table transposition_table_t;
+
+/** @brief Tworzy pustą tablicę transpozycji.
+ * @param[in] entries – minimalna liczba wpisów, liczba dodatnia, jest
+ *                      zaokrąglana w górę do potęgi dwójki.
+ * @return Wskaźnik na utworzoną tablicę lub NULL, gdy nie udało się alokować
+ * pamięci lub parametr jest niepoprawny.
+ */
+transposition_table_t* transposition_new(size_t entries);
+
+/** @brief Usuwa tablicę transpozycji.
+ * Nic nie robi, jeśli wskaźnik ma wartość NULL.
+ * @param[in] table   – wskaźnik na usuwaną tablicę.
+ * @note Wątki: żaden inny wątek nie może w tym czasie używać tablicy.
+ */
+void transposition_delete(transposition_table_t *table);
+
+/** @brief Usuwa wszystkie wpisy z tablicy.
+ * @param[in,out] table – wskaźnik na tablicę.
+ * @note Wątki: żaden inny wątek nie może w tym czasie używać tablicy.
+ */
+void transposition_clear(transposition_table_t *table);
+
+/** @brief Zapisuje wartość pozycji.
+ * Zastępuje wpis o tym samym indeksie, nawet jeśli opisywał inną pozycję.
+ * @param[in,out] table – wskaźnik na tablicę,
+ * @param[in] hash      – skrót pozycji,
+ * @param[in] value     – wartość pozycji.
+ * @note Wątki: może być wywoływana jednocześnie z innymi zapisami i odczytami.
+ */
+void transposition_store(transposition_table_t *table, uint64_t hash, uint64_t value);
+
+/** @brief Odczytuje wartość pozycji.
+ * @param[in] table   – wskaźnik na tablicę,
+ * @param[in] hash    – skrót pozycji,
+ * @param[out] value  – wskaźnik, pod który jest wpisywana wartość pozycji.
+ * @return Wartość @p true, jeśli tablica zawiera pozycję o tym skrócie,
+ * a @p false w przeciwnym przypadku.
+ * @note Wątki: może być wywoływana jednocześnie z innymi zapisami i odczytami.
+ */
+bool transposition_probe(transposition_table_t const *table, uint64_t hash,
+                         uint64_t *value);
+
+/** @brief Podaje liczbę bajtów zajmowanych przez tablicę.
+ * @param[in] table   – wskaźnik na tablicę.
+ * @return Liczba bajtów lub zero, gdy wskaźnik @p table ma wartość NULL.
+ */
+uint64_t transposition_memory_usage(transposition_table_t const *table);
+
+#endif /* TRANSPOSITION_H */
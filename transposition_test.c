@@ -0,0 +1,214 @@
+/** @file
+ * Test of the transposition table.
+ *
+ * Checks storing, replacing and clearing entries, that positions reached
+ * by different orders of moves share their entry through game_hash, and
+ * that threads storing and probing one table at once never read a value
+ * of another position: every value stored for a hash is computed from
+ * the hash, so an entry torn by simultaneous writes which would still be
+ * accepted is detected. The program exits with a failure at the first
+ * wrong result, it is meant to be run also with the thread sanitizer.
+ *
+ * Usage: ./transposition_test [threads [operations]]
+ */
+
+#include "game.h"
+#include "transposition.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+// Default number of threads sharing the table.
+#define DEFAULT_THREADS 8
+
+// Default number of stores and probes of every thread.
+#define DEFAULT_OPERATIONS 1000000
+
+// The number of entries of the shared table, small, so the threads often
+// write the same entries.
+#define SHARED_ENTRIES 1024
+
+// The number of different hashes used by the threads.
+#define SHARED_HASHES 4096
+
+/** @brief One thread of the test:
+ * table           - the shared table,
+ * operations      - the number of stores and probes,
+ * seed            - the seed of the hashes of the thread,
+ * hits            - the number of probes which found their position,
+ * failed          - true if a probe returned a value of another position.
+ */
+typedef struct Worker {
+    transposition_table_t* table;
+    uint64_t operations;
+    uint64_t seed;
+    uint64_t hits;
+    bool failed;
+    pthread_t thread;
+} worker_t;
+
+// Mixes the bits of the value (splitmix64).
+static uint64_t mix(uint64_t value) {
+    value += 0x9E3779B97F4A7C15ULL;
+    value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+
+    return value ^ (value >> 31);
+}
+
+// Exits the program with the message if the condition does not hold.
+static void check(bool condition, char const* message) {
+    if (!condition) {
+        fprintf(stderr, "Failed: %s.\n", message);
+        exit(EXIT_FAILURE);
+    }
+}
+
+// Checks one thread storing, replacing and clearing entries.
+static void test_entries(void) {
+    transposition_table_t* table = transposition_new(100);
+    uint64_t value;
+
+    check(table && transposition_memory_usage(table) > 128 * 2 * sizeof(uint64_t),
+          "the table has 128 entries");
+    check(!transposition_probe(table, 12345, &value), "an empty table has no positions");
+
+    transposition_store(table, 12345, 7);
+    check(transposition_probe(table, 12345, &value) && value == 7, "a stored value is found");
+    check(!transposition_probe(table, 12345 + 128 * 1000, &value),
+          "a position with the same index is not found");
+
+    transposition_store(table, 12345 + 128, 8);
+    check(transposition_probe(table, 12345 + 128, &value) && value == 8,
+          "a new position replaces the entry");
+    check(!transposition_probe(table, 12345, &value), "the replaced position is not found");
+
+    transposition_store(table, 0, 9);
+    check(transposition_probe(table, 0, &value) && value == 9, "the hash zero is stored");
+
+    transposition_clear(table);
+    check(!transposition_probe(table, 0, &value) &&
+          !transposition_probe(table, 12345 + 128, &value), "a cleared table is empty");
+    check(transposition_new(0) == NULL, "a table has at least one entry");
+
+    transposition_delete(table);
+    transposition_delete(NULL);
+}
+
+// Checks that the position reached by two orders of moves is found by
+// the hash of any of them.
+static void test_transpositions(void) {
+    transposition_table_t* table = transposition_new(1 << 10);
+    game_t* first = game_new(10, 10, 2, 3);
+    game_t* second = game_new(10, 10, 2, 3);
+    uint64_t value;
+
+    check(table && first && second, "the games are created");
+
+    game_move(first, 1, 2, 2);
+    game_move(first, 2, 5, 5);
+    game_move(first, 1, 2, 3);
+    transposition_store(table, game_hash(first), 42);
+
+    game_move(second, 1, 2, 3);
+    game_move(second, 2, 5, 5);
+    check(!transposition_probe(table, game_hash(second), &value),
+          "a position before the last move is not found");
+    game_move(second, 1, 2, 2);
+    check(transposition_probe(table, game_hash(second), &value) && value == 42,
+          "the same position after other moves is found");
+
+    game_delete(first);
+    game_delete(second);
+    transposition_delete(table);
+}
+
+// Stores and probes positions of the shared table, the value of a position
+// is computed from its hash.
+static void* work(void* argument) {
+    worker_t* worker = argument;
+    uint64_t state = worker->seed;
+
+    for (uint64_t i = 0; i < worker->operations; i++) {
+        state = mix(state);
+
+        // The hash UINT64_MAX matches a cleared entry.
+        uint64_t hash = mix(state % SHARED_HASHES) & ~1ULL;
+        uint64_t value;
+
+        if (state >> 63) {
+            transposition_store(worker->table, hash, mix(hash ^ 1));
+        }
+        else if (transposition_probe(worker->table, hash, &value)) {
+            worker->hits++;
+            worker->failed |= value != mix(hash ^ 1);
+        }
+    }
+
+    return NULL;
+}
+
+// Checks the threads sharing one table.
+static void test_threads(uint32_t threads, uint64_t operations) {
+    transposition_table_t* table = transposition_new(SHARED_ENTRIES);
+    worker_t* workers = calloc(threads, sizeof(worker_t));
+    uint64_t hits = 0;
+
+    check(table && workers, "the table is created");
+
+    for (uint32_t i = 0; i < threads; i++) {
+        workers[i].table = table;
+        workers[i].operations = operations;
+        workers[i].seed = i + 1;
+
+        check(pthread_create(&workers[i].thread, NULL, work, &workers[i]) == 0,
+              "the thread is created");
+    }
+
+    for (uint32_t i = 0; i < threads; i++) {
+        pthread_join(workers[i].thread, NULL);
+        check(!workers[i].failed, "a probe returns only the value of its position");
+        hits += workers[i].hits;
+    }
+
+    check(hits > 0, "the positions stored by the threads are found");
+    printf("Threads: %u, operations: %lu, probes which found their position: %lu\n",
+           threads, threads * operations, hits);
+
+    free(workers);
+    transposition_delete(table);
+}
+
+// Reads a positive number or exits the program with an error message.
+static uint64_t read_number(const char* string, uint64_t max_value, const char* name) {
+    char* end_string;
+    unsigned long long converted_value = strtoull(string, &end_string, 10);
+
+    if (*string == '\0' || *end_string != '\0' || converted_value == 0 ||
+        converted_value > max_value) {
+        fprintf(stderr, "Invalid %s value: %s\n", name, string);
+        exit(EXIT_FAILURE);
+    }
+
+    return converted_value;
+}
+
+int main(const int argc, const char* argv[]) {
+    if (argc > 3) {
+        fprintf(stderr, "Usage: %s [threads [operations]]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    uint32_t threads = argc > 1 ? (uint32_t)read_number(argv[1], 1024, "threads") :
+                       DEFAULT_THREADS;
+    uint64_t operations = argc > 2 ? read_number(argv[2], UINT32_MAX, "operations") :
+                          DEFAULT_OPERATIONS;
+
+    test_entries();
+    test_transpositions();
+    test_threads(threads, operations);
+    printf("All tests of the transposition table passed.\n");
+
+    return EXIT_SUCCESS;
+}